@@ -5,14 +5,25 @@
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "threads/io.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/slab.h"
+#include "threads/sched-trace.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/workqueue.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
+#include "userprog/syscall.h"
 #endif
 #ifdef FILESYS
 #include "devices/block.h"
 #include "filesys/filesys.h"
 #endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/swap.h"
+#endif
 
 /* Keyboard control register port. */
 #define CONTROL_REG 0x64
@@ -128,6 +139,13 @@ print_stats (void)
 {
   timer_print_stats ();
   thread_print_stats ();
+  mutex_print_stats ();
+  palloc_print_stats ();
+  malloc_print_stats ();
+  kmem_print_stats ();
+  workqueue_print_stats ();
+  if (sched_trace_at_shutdown)
+    sched_trace_dump ();
 #ifdef FILESYS
   block_print_stats ();
 #endif
@@ -135,5 +153,10 @@ print_stats (void)
   kbd_print_stats ();
 #ifdef USERPROG
   exception_print_stats ();
+  syscall_print_stats ();
+#endif
+#ifdef VM
+  frame_print_stats ();
+  swap_print_stats ();
 #endif
 }
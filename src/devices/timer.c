@@ -7,7 +7,8 @@
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
-#include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/workqueue.h"
   
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -41,6 +42,9 @@ struct sleeping_thread
 
 struct list sleeping_threads_list;
 
+/* Cache of struct sleeping_thread objects. */
+static struct kmem_cache *sleeping_thread_cache;
+
 /* Sets up the timer to interrupt TIMER_FREQ times per second,
    and registers the corresponding interrupt. */
 void
@@ -50,6 +54,9 @@ timer_init (void)
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 
   list_init (&sleeping_threads_list);
+  sleeping_thread_cache = kmem_cache_create ("sleeping_thread",
+                                             sizeof (struct sleeping_thread),
+                                             NULL);
 }
 
 /* Calibrates loops_per_tick, used to implement brief delays. */
@@ -109,13 +116,16 @@ timer_sleep (int64_t ticks)
   if (timer_elapsed (start) < ticks)
     {
       struct sleeping_thread * new;
-      new = malloc (sizeof (struct sleeping_thread));
+      new = kmem_cache_alloc (sleeping_thread_cache);
       new->th = thread_current();
       new->ticks_left = --ticks;
-      list_push_back (&sleeping_threads_list, &(new->elem));
       old_level = intr_disable ();
+      list_push_back (&sleeping_threads_list, &(new->elem));
       thread_block ();
       intr_set_level (old_level);
+
+      /* The timer interrupt has taken NEW off the list. */
+      kmem_cache_free (sleeping_thread_cache, new);
     }
 }
 
@@ -197,6 +207,7 @@ timer_interrupt (struct intr_frame *args UNUSED)
 
   ticks++;
   thread_tick ();
+  workqueue_tick (ticks);
 
   for (e = list_begin (&sleeping_threads_list);
        e != list_end (&sleeping_threads_list); e = list_next (e))
@@ -208,8 +219,6 @@ timer_interrupt (struct intr_frame *args UNUSED)
           e = list_prev (e);
 	  thread_unblock (st->th);
 	}
-      else if (st->ticks_left < 0)
-	free (st);
       else
 	{
 	  st->ticks_left--;
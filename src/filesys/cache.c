@@ -2,34 +2,82 @@
 #include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "devices/timer.h"
 #include "threads/thread.h"
+#include "threads/workqueue.h"
+
+/* Maximum number of blocks in the cache. */
+#define CACHE_SIZE 64
+
+/* Timer ticks between write-backs of the whole cache. */
+#define FLUSH_INTERVAL (60 * TIMER_FREQ)
+
+/* Cache of struct cache_block objects. */
+static struct kmem_cache *cache_block_cache;
+
+/* Periodic write-back, rescheduled by itself. */
+static struct work flush_work;
+
+/* A pending read-ahead of one sector. */
+struct read_ahead
+  {
+    struct work work;
+    block_sector_t sector;
+  };
+
+static struct cache_block *fetch_cache_block (block_sector_t, void *,
+                                              bool ahead);
+static struct cache_block *get_cache_block (block_sector_t, bool fill,
+                                            bool *miss);
 
 static void
-read_ahead (block_sector_t sector)
+read_ahead (struct work *w)
 {
-  read_cache_block (sector + 1, NULL);
+  struct read_ahead *ra = w->aux;
+
+  mutex_acquire (&cache_lock);
+  if (cache_lookup (ra->sector) == NULL)
+    get_cache_block (ra->sector, true, NULL);
+  mutex_release (&cache_lock);
+  free (ra);
 }
 
+/* Queues a low-priority read of SECTOR into the cache, if it
+   exists on the file system device. */
 static void
-buffer_cache_flush ()
+schedule_read_ahead (block_sector_t sector)
 {
-  while (true)
-    {
-      timer_msleep (60 * 1000);
-      write_back_cache_blocks ();
-    }
+  struct read_ahead *ra;
+
+  if (sector >= block_size (fs_device))
+    return;
+  ra = malloc (sizeof *ra);
+  if (ra == NULL)
+    return;
+  ra->sector = sector;
+  work_init (&ra->work, read_ahead, ra, WORK_LOW);
+  work_submit (&ra->work);
+}
+
+static void
+buffer_cache_flush (struct work *w)
+{
+  write_back_cache_blocks ();
+  work_submit_delayed (w, FLUSH_INTERVAL);
 }
+
 void
 cache_init ()
 {
-  tid_t tid;
-
   list_init (&buffer_cache);
-  sema_init (&sema_cache, 1);
+  mutex_init (&cache_lock);
   hash_init (&buffer_cache_table, cache_hash, cache_less, NULL);
+  cache_block_cache = kmem_cache_create ("cache_block",
+                                         sizeof (struct cache_block), NULL);
 
-  tid = thread_create ("buffer_cache_flush", PRI_DEFAULT, buffer_cache_flush, NULL);
+  work_init (&flush_work, buffer_cache_flush, NULL, WORK_NORMAL);
+  work_submit_delayed (&flush_work, FLUSH_INTERVAL);
 }
 unsigned
 cache_hash (const struct hash_elem *p_, void *aux UNUSED)
@@ -48,158 +96,225 @@ cache_less (const struct hash_elem *a_, const struct hash_elem *b_,
   return a->inode_sector < b->inode_sector;
 }
 
+/* Returns the cache block holding SECTOR, or a null pointer if
+   it is not cached.  The caller must hold cache_lock. */
 struct cache_block *
 cache_lookup (block_sector_t sector)
 {
   struct cache_block c;
   struct hash_elem *e;
 
+  ASSERT (mutex_held_by_current_thread (&cache_lock));
+
   c.inode_sector = sector;
   e = hash_find (&buffer_cache_table, &c.hash_elem);
   return e != NULL ? hash_entry (e, struct cache_block, hash_elem) : NULL;
 }
 
+/* Waits until the I/O in progress on CB finishes.  Drops
+   cache_lock while waiting, so CB may hold a different sector,
+   or none, by the time this returns with the lock held again. */
+static void
+wait_for_io (struct cache_block *cb)
+{
+  ASSERT (cb->busy);
 
-struct cache_block *
-read_cache_block (block_sector_t sector_idx, void *buffer)
+  cb->waiter_cnt++;
+  mutex_release (&cache_lock);
+  sema_down (&cb->io_done);
+  mutex_acquire (&cache_lock);
+}
+
+/* Marks the I/O in progress on CB finished and wakes the threads
+   waiting for it. */
+static void
+finish_io (struct cache_block *cb)
+{
+  ASSERT (cb->busy);
+
+  cb->busy = false;
+  for (; cb->waiter_cnt > 0; cb->waiter_cnt--)
+    sema_up (&cb->io_done);
+}
+
+/* Returns the least recently used block with no I/O in
+   progress, or a null pointer if every block is busy. */
+static struct cache_block *
+pick_victim (void)
 {
-  struct list *list;
-  struct hash *hash;
   struct list_elem *e;
-  struct cache_block *cb = NULL;
-  size_t size;
-  list = &buffer_cache;
-  hash = &buffer_cache_table;
-  
-  cb = cache_lookup (sector_idx);
-  if (cb)
-    {
-      if (buffer)
-	  memcpy (buffer, cb->data, BLOCK_SECTOR_SIZE);	
-      sema_down (&sema_cache);
-      list_remove (&cb->elem);
-      list_push_front (list, &cb->elem);
-      sema_up (&sema_cache);
-      return cb;
-    }
-  else
+
+  for (e = list_rbegin (&buffer_cache); e != list_rend (&buffer_cache);
+       e = list_prev (e))
     {
-      tid_t tid;
-      sema_down (&sema_cache);
-      size = list_size (list);
-      sema_up (&sema_cache);
-      if (size == 64)
-	{
-	  struct cache_block *victim_block = list_entry (list_rbegin (list),
-							 struct cache_block,
-							 elem);
-	  block_write (fs_device, victim_block->inode_sector, victim_block->data);
-	  block_read (fs_device, sector_idx, victim_block->data);
-	  sema_down (&sema_cache);
-	  list_remove (&victim_block->elem);
-	  hash_delete (hash, &victim_block->hash_elem);
-	  victim_block->inode_sector = sector_idx;
-	  list_push_front (list, &victim_block->elem);
-	  hash_insert (hash, &victim_block->hash_elem);
-	  sema_up (&sema_cache);
-	  if (buffer)
-	    memcpy (buffer, victim_block->data, BLOCK_SECTOR_SIZE);
-	  if (sector_idx % 2 == 0)
-	    ;//	    tid = thread_create ("read_ahead", PRI_DEFAULT - 10, read_ahead, sector_idx);
-	  return victim_block;
-	}
-      else
-	{
-	  struct cache_block *c = malloc (sizeof (struct cache_block));
-	  c->inode_sector = sector_idx;
-	  block_read (fs_device, sector_idx, c->data);
-	  sema_down (&sema_cache);
-	  list_push_front (list, &c->elem);
-	  hash_insert (hash, &c->hash_elem);
-	  sema_up (&sema_cache);
-	  if (buffer)
-	    memcpy (buffer, c->data, BLOCK_SECTOR_SIZE);
-	  if (sector_idx % 2 == 0)
-	    ;//	    tid = thread_create ("read_ahead", PRI_DEFAULT - 10, read_ahead, sector_idx);
-	  return c;
-	}
+      struct cache_block *cb = list_entry (e, struct cache_block, elem);
+      if (!cb->busy)
+        return cb;
     }
   return NULL;
 }
 
+/* Returns the cache block for SECTOR, moved to the front of the
+   LRU list.  On a miss, takes a free block or the least recently
+   used one, reads SECTOR into it if FILL is true, and sets
+   *MISS, if MISS is non-null.  The caller must hold cache_lock.
 
-struct cache_block *
-write_cache_block (block_sector_t sector_idx, void *buffer)
+   Disk I/O runs with cache_lock dropped and the block marked
+   busy, so that hits on other blocks do not wait for it.  A busy
+   block stays in the table under the sector it is being read or
+   written for, and lookups of that sector wait for the I/O to
+   finish instead of going to the disk themselves.  A dirty
+   victim is written back under its old sector before it is
+   reused, so that a reader of that sector cannot miss and read
+   stale data from the disk. */
+static struct cache_block *
+get_cache_block (block_sector_t sector, bool fill, bool *miss)
 {
-  struct list *list;
-  struct hash *hash;
-  struct list_elem *e;
-  struct cache_block *cb = NULL;
-  size_t size;
-  list = &buffer_cache;
-  hash = &buffer_cache_table;
+  struct cache_block *cb;
+
+  ASSERT (mutex_held_by_current_thread (&cache_lock));
 
-  cb = cache_lookup (sector_idx);
-  if (cb)
+  if (miss != NULL)
+    *miss = false;
+  for (;;)
     {
-      memcpy (cb->data, buffer, BLOCK_SECTOR_SIZE);
-      sema_down (&sema_cache);
-      list_remove (&cb->elem);
-      list_push_front (list, &cb->elem);
-      sema_up (&sema_cache);
+      cb = cache_lookup (sector);
+      if (cb != NULL)
+        {
+          if (cb->busy)
+            {
+              wait_for_io (cb);
+              continue;
+            }
+          list_remove (&cb->elem);
+          list_push_front (&buffer_cache, &cb->elem);
+          return cb;
+        }
+
+      cb = NULL;
+      if (list_size (&buffer_cache) < CACHE_SIZE)
+        {
+          cb = kmem_cache_alloc (cache_block_cache);
+          if (cb != NULL)
+            {
+              cb->waiter_cnt = 0;
+              sema_init (&cb->io_done, 0);
+            }
+        }
+      if (cb == NULL)
+        {
+          cb = pick_victim ();
+          if (cb == NULL)
+            {
+              if (list_empty (&buffer_cache))
+                PANIC ("buffer cache: out of memory");
+              wait_for_io (list_entry (list_back (&buffer_cache),
+                                       struct cache_block, elem));
+              continue;
+            }
+          if (cb->dirty)
+            {
+              cb->busy = true;
+              cb->dirty = false;
+              mutex_release (&cache_lock);
+              block_write (fs_device, cb->inode_sector, cb->data);
+              mutex_acquire (&cache_lock);
+              finish_io (cb);
+
+              /* SECTOR may have been cached meanwhile. */
+              continue;
+            }
+          list_remove (&cb->elem);
+          hash_delete (&buffer_cache_table, &cb->hash_elem);
+        }
+
+      cb->inode_sector = sector;
+      cb->dirty = false;
+      cb->busy = fill;
+      list_push_front (&buffer_cache, &cb->elem);
+      hash_insert (&buffer_cache_table, &cb->hash_elem);
+      if (miss != NULL)
+        *miss = true;
+      if (fill)
+        {
+          mutex_release (&cache_lock);
+          block_read (fs_device, sector, cb->data);
+          mutex_acquire (&cache_lock);
+          finish_io (cb);
+        }
       return cb;
     }
-  else
-    {
-      sema_down (&sema_cache);
-      size = list_size (list);
-      sema_up (&sema_cache);
-      if (size == 64)
-	{
-	  struct cache_block *victim_block = list_entry (list_rbegin (list),
-							 struct cache_block,
-							 elem);
-	  block_write (fs_device, victim_block->inode_sector, victim_block->data);
-	  memcpy (victim_block->data, buffer, BLOCK_SECTOR_SIZE);
-	  sema_down (&sema_cache);
-	  list_remove (&victim_block->elem);
-	  hash_delete (hash, &victim_block->hash_elem);
-	  victim_block->inode_sector = sector_idx;
-	  list_push_front (list, &victim_block->elem);
-	  hash_insert (hash, &victim_block->hash_elem);
-	  sema_up (&sema_cache);
-	  return victim_block;
-	}
-      else
-	{
-	  struct cache_block *c = malloc (sizeof (struct cache_block));
-	  c->inode_sector = sector_idx;
-	  memcpy (c->data, buffer, BLOCK_SECTOR_SIZE);
-	  sema_down (&sema_cache);
-	  list_push_front (list, &c->elem);
-	  hash_insert (hash, &c->hash_elem);
-	  sema_up (&sema_cache);
-	  return c;
-	}
-    }
-  return NULL;
 }
 
+struct cache_block *
+read_cache_block (block_sector_t sector_idx, void *buffer)
+{
+  return fetch_cache_block (sector_idx, buffer, true);
+}
+
+/* Reads SECTOR_IDX through the cache into BUFFER, if non-null,
+   and returns its cache block.  On a miss, if AHEAD is
+   true, also queues a read of the following sector. */
+static struct cache_block *
+fetch_cache_block (block_sector_t sector_idx, void *buffer, bool ahead)
+{
+  struct cache_block *cb;
+  bool miss;
+
+  mutex_acquire (&cache_lock);
+  cb = get_cache_block (sector_idx, true, &miss);
+  if (buffer)
+    memcpy (buffer, cb->data, BLOCK_SECTOR_SIZE);
+  mutex_release (&cache_lock);
+
+  if (miss && ahead && sector_idx % 2 == 0)
+    schedule_read_ahead (sector_idx + 1);
+  return cb;
+}
+
+struct cache_block *
+write_cache_block (block_sector_t sector_idx, void *buffer)
+{
+  struct cache_block *cb;
+
+  mutex_acquire (&cache_lock);
+  cb = get_cache_block (sector_idx, false, NULL);
+  memcpy (cb->data, buffer, BLOCK_SECTOR_SIZE);
+  cb->dirty = true;
+  mutex_release (&cache_lock);
+  return cb;
+}
+
+/* Writes every dirty block back to disk.  Blocks stay cached.
+   Each write runs with cache_lock dropped, like the I/O in
+   get_cache_block(). */
 void
 write_back_cache_blocks ()
 {
-  struct list *list;
   struct list_elem *e;
+  int i;
 
-  list = &buffer_cache;
-  for (e = list_begin (list); e != list_end (list);)
+  mutex_acquire (&cache_lock);
+  for (i = 0; i < CACHE_SIZE; i++)
     {
-      struct cache_block *cb = list_entry (e, struct cache_block, elem);
+      struct cache_block *cb = NULL;
+
+      for (e = list_begin (&buffer_cache); e != list_end (&buffer_cache);
+           e = list_next (e))
+        {
+          cb = list_entry (e, struct cache_block, elem);
+          if (cb->dirty && !cb->busy)
+            break;
+        }
+      if (e == list_end (&buffer_cache))
+        break;
+
+      cb->busy = true;
+      cb->dirty = false;
+      mutex_release (&cache_lock);
       block_write (fs_device, cb->inode_sector, cb->data);
-      sema_down (&sema_cache);
-      e = list_remove (&cb->elem);
-      hash_delete (&buffer_cache_table, &cb->hash_elem);
-      sema_up (&sema_cache);
-      free (cb);
+      mutex_acquire (&cache_lock);
+      finish_io (cb);
     }
+  mutex_release (&cache_lock);
 }
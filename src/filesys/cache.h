@@ -9,6 +9,10 @@ struct cache_block
 {
   block_sector_t inode_sector;
   uint8_t data[BLOCK_SECTOR_SIZE];
+  bool dirty;                   /* Written since last write-back? */
+  bool busy;                    /* Disk I/O in progress? */
+  unsigned waiter_cnt;          /* Threads waiting for the I/O. */
+  struct semaphore io_done;     /* Upped once per waiter after the I/O. */
   struct list_elem elem;
   struct hash_elem hash_elem;
 };
@@ -22,7 +26,8 @@ cache_less (const struct hash_elem *, const struct hash_elem *,
 
 struct list buffer_cache;
 struct hash buffer_cache_table;
-struct semaphore sema_cache;
+struct mutex cache_lock;
+struct cache_block * cache_lookup (block_sector_t);
 struct cache_block * read_cache_block (block_sector_t, void *);
 struct cache_block * write_cache_block (block_sector_t, void *);
 void write_back_cache_blocks (void);
@@ -5,6 +5,7 @@
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
 #include "filesys/cache.h"
 #include "filesys/free-map.h"
@@ -32,12 +33,22 @@ dir_create (block_sector_t sector, size_t entry_cnt)
   return inode_create (sector, entry_cnt * sizeof (struct dir_entry), true);
 }
 
+/* Cache of struct dir objects. */
+static struct kmem_cache *dir_cache;
+
+/* Initializes the directory module. */
+void
+dir_init (void) 
+{
+  dir_cache = kmem_cache_create ("dir", sizeof (struct dir), NULL);
+}
+
 /* Opens and returns the directory for the given INODE, of which
    it takes ownership.  Returns a null pointer on failure. */
 struct dir *
 dir_open (struct inode *inode) 
 {
-  struct dir *dir = calloc (1, sizeof *dir);
+  struct dir *dir = kmem_cache_alloc (dir_cache);
   if (inode != NULL && dir != NULL)
     {
       dir->inode = inode;
@@ -47,7 +58,7 @@ dir_open (struct inode *inode)
   else
     {
       inode_close (inode);
-      free (dir);
+      kmem_cache_free (dir_cache, dir);
       return NULL; 
     }
 }
@@ -75,7 +86,7 @@ dir_close (struct dir *dir)
   if (dir != NULL)
     {
       inode_close (dir->inode);
-      free (dir);
+      kmem_cache_free (dir_cache, dir);
     }
 }
 
@@ -1,7 +1,9 @@
 #include "filesys/file.h"
 #include <debug.h>
+#include <iovec.h>
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "filesys/directory.h"
 #include "filesys/inode.h"
 /* An open file. */
@@ -12,13 +14,23 @@ struct file
     bool deny_write;            /* Has file_deny_write() been called? */
   };
 
+/* Cache of struct file objects. */
+static struct kmem_cache *file_cache;
+
+/* Initializes the file module. */
+void
+file_init (void) 
+{
+  file_cache = kmem_cache_create ("file", sizeof (struct file), NULL);
+}
+
 /* Opens a file for the given INODE, of which it takes ownership,
    and returns the new file.  Returns a null pointer if an
    allocation fails or if INODE is null. */
 struct file *
 file_open (struct inode *inode) 
 {
-  struct file *file = calloc (1, sizeof *file);
+  struct file *file = kmem_cache_alloc (file_cache);
   if (inode != NULL && file != NULL && inode_is_file (inode))
     {
       file->inode = inode;
@@ -29,7 +41,7 @@ file_open (struct inode *inode)
   else
     {
       inode_close (inode);
-      free (file);
+      kmem_cache_free (file_cache, file);
       return NULL; 
     }
 }
@@ -50,7 +62,7 @@ file_close (struct file *file)
     {
       file_allow_write (file);
       inode_close (file->inode);
-      free (file); 
+      kmem_cache_free (file_cache, file);
     }
 }
 
@@ -114,6 +126,82 @@ file_write_at (struct file *file, const void *buffer, off_t size,
   return inode_write_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Reads from FILE into the CNT buffers in IOV, filling each in
+   turn, starting at the file's current position.
+   Returns the number of bytes actually read,
+   which may be less than the buffers' total size if end of file
+   is reached.
+   Advances FILE's position by the number of bytes read. */
+off_t
+file_readv (struct file *file, const struct iovec *iov, int cnt) 
+{
+  off_t bytes_read = file_readv_at (file, iov, cnt, file->pos);
+  file->pos += bytes_read;
+  return bytes_read;
+}
+
+/* Reads from FILE into the CNT buffers in IOV, filling each in
+   turn, starting at offset FILE_OFS in the file.
+   Returns the number of bytes actually read,
+   which may be less than the buffers' total size if end of file
+   is reached.
+   The file's current position is unaffected. */
+off_t
+file_readv_at (struct file *file, const struct iovec *iov, int cnt,
+               off_t file_ofs) 
+{
+  off_t bytes_read = 0;
+  int i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      off_t n = inode_read_at (file->inode, iov[i].iov_base,
+                               iov[i].iov_len, file_ofs + bytes_read);
+      bytes_read += n;
+      if (n < (off_t) iov[i].iov_len)
+        break;
+    }
+  return bytes_read;
+}
+
+/* Writes the CNT buffers in IOV, one after another, into FILE,
+   starting at the file's current position.
+   Returns the number of bytes actually written,
+   which may be less than the buffers' total size if an error
+   occurs.
+   Advances FILE's position by the number of bytes written. */
+off_t
+file_writev (struct file *file, const struct iovec *iov, int cnt) 
+{
+  off_t bytes_written = file_writev_at (file, iov, cnt, file->pos);
+  file->pos += bytes_written;
+  return bytes_written;
+}
+
+/* Writes the CNT buffers in IOV, one after another, into FILE,
+   starting at offset FILE_OFS in the file.
+   Returns the number of bytes actually written,
+   which may be less than the buffers' total size if an error
+   occurs.
+   The file's current position is unaffected. */
+off_t
+file_writev_at (struct file *file, const struct iovec *iov, int cnt,
+                off_t file_ofs) 
+{
+  off_t bytes_written = 0;
+  int i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      off_t n = inode_write_at (file->inode, iov[i].iov_base,
+                                iov[i].iov_len, file_ofs + bytes_written);
+      bytes_written += n;
+      if (n < (off_t) iov[i].iov_len)
+        break;
+    }
+  return bytes_written;
+}
+
 /* Prevents write operations on FILE's underlying inode
    until file_allow_write() is called or FILE is closed. */
 void
@@ -4,6 +4,9 @@
 #include "filesys/off_t.h"
 
 struct inode;
+struct iovec;
+
+void file_init (void);
 
 /* Opening and closing files. */
 struct file *file_open (struct inode *);
@@ -16,6 +19,12 @@ off_t file_read (struct file *, void *, off_t);
 off_t file_read_at (struct file *, void *, off_t size, off_t start);
 off_t file_write (struct file *, const void *, off_t);
 off_t file_write_at (struct file *, const void *, off_t size, off_t start);
+off_t file_readv (struct file *, const struct iovec *, int cnt);
+off_t file_readv_at (struct file *, const struct iovec *, int cnt,
+                     off_t start);
+off_t file_writev (struct file *, const struct iovec *, int cnt);
+off_t file_writev_at (struct file *, const struct iovec *, int cnt,
+                      off_t start);
 
 /* Preventing writes. */
 void file_deny_write (struct file *);
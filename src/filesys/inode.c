@@ -6,6 +6,7 @@
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "filesys/cache.h"
 #include "threads/thread.h"
 /* Identifies an inode. */
@@ -43,6 +44,7 @@ struct inode
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    unsigned write_cnt;                 /* Number of writes while open. */
     struct inode_disk data;             /* Inode content. */
     struct semaphore sema;
     struct semaphore dir_sema;
@@ -102,12 +104,28 @@ byte_to_sector (const struct inode *inode, off_t pos)
    returns the same `struct inode'. */
 static struct list open_inodes;
 struct semaphore sema;
+
+/* Cache of struct inode objects. */
+static struct kmem_cache *inode_cache;
+static kmem_ctor_func inode_ctor;
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
   list_init (&open_inodes);
   sema_init (&sema, 1);
+  inode_cache = kmem_cache_create ("inode", sizeof (struct inode), inode_ctor);
+}
+
+/* Constructor for inode_cache objects.  An inode is freed only
+   when nothing holds its semaphores, so they stay constructed. */
+static void
+inode_ctor (void *inode_) 
+{
+  struct inode *inode = inode_;
+
+  sema_init (&inode->sema, 1);
+  sema_init (&inode->dir_sema, 1);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -255,7 +273,7 @@ inode_open (block_sector_t sector)
     }
 
   /* Allocate memory. */
-  inode = malloc (sizeof *inode);
+  inode = kmem_cache_alloc (inode_cache);
   if (inode == NULL)
     return NULL;
 
@@ -266,9 +284,8 @@ inode_open (block_sector_t sector)
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
+  inode->write_cnt = 0;
   inode->removed = false;
-  sema_init (&inode->sema, 1);
-  sema_init (&inode->dir_sema, 1);
   read_cache_block (inode->sector, &inode->data);
   //  block_read (fs_device, inode->sector, &inode->data);
   return inode;
@@ -318,7 +335,7 @@ inode_close (struct inode *inode)
 	    }
         }
 
-      free (inode); 
+      kmem_cache_free (inode_cache, inode);
     }
 }
 
@@ -339,13 +356,18 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
+  uint8_t *bounce = NULL;
+
   while (size > 0) 
     {
       /* Disk sector to read, starting byte offset within sector. */
 
       block_sector_t sector_idx = byte_to_sector (inode, offset);
       if (sector_idx == -1)
-	return 0;
+	{
+	  free (bounce);
+	  return 0;
+	}
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
@@ -367,16 +389,26 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
         }
       else 
         {
+          /* Read sector into bounce buffer, then partially copy
+             into caller's buffer.  The cache block itself may be
+             reused as soon as the cache lock is dropped. */
+          if (bounce == NULL) 
+            {
+              bounce = malloc (BLOCK_SECTOR_SIZE);
+              if (bounce == NULL)
+                break;
+            }
 	  sema_down (&inode->sema);
-	  struct cache_block *cb = read_cache_block (sector_idx, NULL);
+	  read_cache_block (sector_idx, bounce);
 	  sema_up (&inode->sema);
-	  memcpy (buffer + bytes_read, (void *) &cb->data + sector_ofs, chunk_size);
+	  memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
         }
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_read += chunk_size;
     }
+  free (bounce);
 
   return bytes_read;
 }
@@ -546,6 +578,7 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 
   if (inode->deny_write_cnt)
     return 0;
+  inode->write_cnt++;
 
   if (ROUND_UP (inode->data.length, BLOCK_SECTOR_SIZE) < ROUND_UP (offset, BLOCK_SECTOR_SIZE))
     {
@@ -675,6 +708,16 @@ inode_is_file (struct inode *inode)
   return inode->data.type == FILE;
 }
 
+/* Returns the number of times INODE has been written since it
+   was opened.  Anyone who caches something derived from INODE's
+   contents can hold it open and compare this count to tell
+   whether the cached copy is still good. */
+unsigned
+inode_write_cnt (const struct inode *inode)
+{
+  return inode->write_cnt;
+}
+
 bool
 inode_removed (struct inode *inode)
 {
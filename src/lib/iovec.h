@@ -0,0 +1,16 @@
+#ifndef __LIB_IOVEC_H
+#define __LIB_IOVEC_H
+
+#include <stddef.h>
+
+/* One buffer of a vectored read or write. */
+struct iovec
+  {
+    void *iov_base;             /* Start of buffer. */
+    size_t iov_len;             /* Size of buffer in bytes. */
+  };
+
+/* Maximum number of buffers in one readv() or writev(). */
+#define IOV_MAX 16
+
+#endif /* lib/iovec.h */
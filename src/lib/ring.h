@@ -0,0 +1,63 @@
+#ifndef __LIB_RING_H
+#define __LIB_RING_H
+
+/* Submission ring shared between a user process and the kernel.
+
+   The process registers a struct ring in its own memory with
+   ring_setup().  To issue operations, it fills in entries of SQ
+   starting at index SQ_TAIL % RING_ENTRIES and then advances
+   SQ_TAIL past them.  A single ring_enter() system call makes
+   the kernel carry out every submitted operation, in order,
+   posting one completion per operation in CQ at CQ_TAIL, until
+   the submission queue is empty or the completion queue is full.
+   The process consumes completions from CQ_HEAD.
+
+   The four indexes run freely and wrap around at UINT_MAX, so
+   the number of entries in a queue is always TAIL - HEAD.  The
+   kernel writes only SQ_HEAD, CQ_TAIL, and CQ; the process
+   writes only SQ_TAIL, CQ_HEAD, and SQ. */
+
+/* Number of entries in each queue. */
+#define RING_ENTRIES 32
+
+/* Operations. */
+enum ring_op
+  {
+    RING_NOP,                   /* Does nothing, result 0. */
+    RING_READ,                  /* read (FD, BUF, LEN). */
+    RING_WRITE,                 /* write (FD, BUF, LEN). */
+    RING_OPEN,                  /* open (BUF), a file name. */
+    RING_CLOSE,                 /* close (FD), result 0 on success. */
+    RING_SEEK                   /* seek (FD, OFS), result 0 on success. */
+  };
+
+/* A submitted operation. */
+struct ring_sqe
+  {
+    int op;                     /* One of enum ring_op. */
+    int fd;                     /* File descriptor. */
+    void *buf;                  /* Buffer or file name. */
+    unsigned len;               /* Size of BUF. */
+    unsigned ofs;               /* File position. */
+    unsigned user_data;         /* Copied to the completion. */
+  };
+
+/* A completed operation. */
+struct ring_cqe
+  {
+    unsigned user_data;         /* From the submission. */
+    int res;                    /* Result, or -1 on failure. */
+  };
+
+/* A submission queue and a completion queue. */
+struct ring
+  {
+    unsigned sq_head;           /* Next submission the kernel takes. */
+    unsigned sq_tail;           /* Next free submission slot. */
+    unsigned cq_head;           /* Next completion the process takes. */
+    unsigned cq_tail;           /* Next free completion slot. */
+    struct ring_sqe sq[RING_ENTRIES];
+    struct ring_cqe cq[RING_ENTRIES];
+  };
+
+#endif /* lib/ring.h */
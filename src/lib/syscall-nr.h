@@ -28,7 +28,19 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Extensions. */
+    SYS_SCHED_TRACE,            /* Prints the scheduler trace. */
+    SYS_FORK,                   /* Duplicates the current process. */
+    SYS_READV,                  /* Read into several buffers. */
+    SYS_WRITEV,                 /* Write from several buffers. */
+    SYS_PREAD,                  /* Read at a given offset. */
+    SYS_PWRITE,                 /* Write at a given offset. */
+    SYS_RING_SETUP,             /* Register a submission ring. */
+    SYS_RING_ENTER,             /* Process submitted operations. */
+    SYS_PIPE,                   /* Create a pipe. */
+    SYS_DUP2                    /* Duplicate a descriptor. */
   };
 
 #endif /* lib/syscall-nr.h */
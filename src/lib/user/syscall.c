@@ -1,31 +1,50 @@
 #include <syscall.h>
+#include <stdint.h>
 #include "../syscall-nr.h"
 
+/* Nonzero if the CPU supports SYSENTER, as reported by CPUID.
+   Set by syscall_init() before main() runs.  The kernel only
+   programs the SYSENTER MSRs on such CPUs. */
+static int use_sysenter __attribute__ ((used));
+
+/* Instructions that enter the kernel, with SYSENTER if the CPU
+   supports it and int $0x30 otherwise.  The system call number
+   and arguments must already be on the stack.  On the SYSENTER
+   path the kernel returns with SYSEXIT to the address in %edx,
+   restoring the stack pointer from %ecx, so those two registers
+   are clobbered. */
+#define SYSCALL_TRAP                                            \
+        "cmpl $0, use_sysenter; je 2f; "                        \
+        "movl %%esp, %%ecx; movl $1f, %%edx; sysenter; "        \
+        "2: int $0x30; 1: "
+
 /* Invokes syscall NUMBER, passing no arguments, and returns the
    return value as an `int'. */
 #define syscall0(NUMBER)                                        \
         ({                                                      \
           int retval;                                           \
           asm volatile                                          \
-            ("pushl %[number]; int $0x30; addl $4, %%esp"       \
+            ("pushl %[number]; " SYSCALL_TRAP                   \
+             "addl $4, %%esp"                                   \
                : "=a" (retval)                                  \
                : [number] "i" (NUMBER)                          \
-               : "memory");                                     \
+               : "ecx", "edx", "memory");                       \
           retval;                                               \
         })
 
 /* Invokes syscall NUMBER, passing argument ARG0, and returns the
    return value as an `int'. */
-#define syscall1(NUMBER, ARG0)                                           \
-        ({                                                               \
-          int retval;                                                    \
-          asm volatile                                                   \
-            ("pushl %[arg0]; pushl %[number]; int $0x30; addl $8, %%esp" \
-               : "=a" (retval)                                           \
-               : [number] "i" (NUMBER),                                  \
-                 [arg0] "g" (ARG0)                                       \
-               : "memory");                                              \
-          retval;                                                        \
+#define syscall1(NUMBER, ARG0)                                  \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("pushl %[arg0]; pushl %[number]; " SYSCALL_TRAP    \
+             "addl $8, %%esp"                                   \
+               : "=a" (retval)                                  \
+               : [number] "i" (NUMBER),                         \
+                 [arg0] "g" (ARG0)                              \
+               : "ecx", "edx", "memory");                       \
+          retval;                                               \
         })
 
 /* Invokes syscall NUMBER, passing arguments ARG0 and ARG1, and
@@ -35,12 +54,13 @@
           int retval;                                           \
           asm volatile                                          \
             ("pushl %[arg1]; pushl %[arg0]; "                   \
-             "pushl %[number]; int $0x30; addl $12, %%esp"      \
+             "pushl %[number]; " SYSCALL_TRAP                   \
+             "addl $12, %%esp"                                  \
                : "=a" (retval)                                  \
                : [number] "i" (NUMBER),                         \
                  [arg0] "r" (ARG0),                             \
                  [arg1] "r" (ARG1)                              \
-               : "memory");                                     \
+               : "ecx", "edx", "memory");                       \
           retval;                                               \
         })
 
@@ -51,16 +71,51 @@
           int retval;                                           \
           asm volatile                                          \
             ("pushl %[arg2]; pushl %[arg1]; pushl %[arg0]; "    \
-             "pushl %[number]; int $0x30; addl $16, %%esp"      \
+             "pushl %[number]; " SYSCALL_TRAP                   \
+             "addl $16, %%esp"                                  \
                : "=a" (retval)                                  \
                : [number] "i" (NUMBER),                         \
                  [arg0] "r" (ARG0),                             \
                  [arg1] "r" (ARG1),                             \
                  [arg2] "r" (ARG2)                              \
-               : "memory");                                     \
+               : "ecx", "edx", "memory");                       \
+          retval;                                               \
+        })
+
+/* Invokes syscall NUMBER, passing arguments ARG0, ARG1, ARG2,
+   and ARG3, and returns the return value as an `int'. */
+#define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3)                \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("pushl %[arg3]; pushl %[arg2]; "                   \
+             "pushl %[arg1]; pushl %[arg0]; "                   \
+             "pushl %[number]; " SYSCALL_TRAP                   \
+             "addl $20, %%esp"                                  \
+               : "=a" (retval)                                  \
+               : [number] "i" (NUMBER),                         \
+                 [arg0] "r" (ARG0),                             \
+                 [arg1] "r" (ARG1),                             \
+                 [arg2] "r" (ARG2),                             \
+                 [arg3] "r" (ARG3)                              \
+               : "ecx", "edx", "memory");                       \
           retval;                                               \
         })
 
+/* CPUID leaf 1 EDX bit for SYSENTER and SYSEXIT. */
+#define CPUID_SEP (1 << 11)
+
+/* Chooses how system calls enter the kernel.  Called by _start()
+   before any system call is made. */
+void
+syscall_init (void) 
+{
+  uint32_t a, b, c, d;
+
+  asm volatile ("cpuid" : "=a" (a), "=b" (b), "=c" (c), "=d" (d) : "a" (1));
+  use_sysenter = (d & CPUID_SEP) != 0;
+}
+
 void
 halt (void) 
 {
@@ -182,3 +237,63 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+void
+sched_trace (void) 
+{
+  syscall0 (SYS_SCHED_TRACE);
+}
+
+pid_t
+fork (void) 
+{
+  return (pid_t) syscall0 (SYS_FORK);
+}
+
+int
+readv (int fd, const struct iovec *iov, int cnt) 
+{
+  return syscall3 (SYS_READV, fd, iov, cnt);
+}
+
+int
+writev (int fd, const struct iovec *iov, int cnt) 
+{
+  return syscall3 (SYS_WRITEV, fd, iov, cnt);
+}
+
+int
+pread (int fd, void *buffer, unsigned length, unsigned offset) 
+{
+  return syscall4 (SYS_PREAD, fd, buffer, length, offset);
+}
+
+int
+pwrite (int fd, const void *buffer, unsigned length, unsigned offset) 
+{
+  return syscall4 (SYS_PWRITE, fd, buffer, length, offset);
+}
+
+bool
+ring_setup (struct ring *ring) 
+{
+  return syscall1 (SYS_RING_SETUP, ring);
+}
+
+int
+ring_enter (void) 
+{
+  return syscall0 (SYS_RING_ENTER);
+}
+
+bool
+pipe (int fds[2]) 
+{
+  return syscall1 (SYS_PIPE, fds);
+}
+
+int
+dup2 (int old_fd, int new_fd) 
+{
+  return syscall2 (SYS_DUP2, old_fd, new_fd);
+}
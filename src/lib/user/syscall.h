@@ -3,6 +3,8 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <iovec.h>
+#include <ring.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -19,6 +21,10 @@ typedef int mapid_t;
 #define EXIT_SUCCESS 0          /* Successful execution. */
 #define EXIT_FAILURE 1          /* Unsuccessful execution. */
 
+/* Chooses how system calls enter the kernel.  Called by the
+   startup code in lib/user/entry.c before main(). */
+void syscall_init (void);
+
 /* Projects 2 and later. */
 void halt (void) NO_RETURN;
 void exit (int status) NO_RETURN;
@@ -45,4 +51,16 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+void sched_trace (void);
+pid_t fork (void);
+int readv (int fd, const struct iovec *, int cnt);
+int writev (int fd, const struct iovec *, int cnt);
+int pread (int fd, void *buffer, unsigned length, unsigned offset);
+int pwrite (int fd, const void *buffer, unsigned length, unsigned offset);
+bool ring_setup (struct ring *);
+int ring_enter (void);
+bool pipe (int fds[2]);
+int dup2 (int old_fd, int new_fd);
+
 #endif /* lib/user/syscall.h */
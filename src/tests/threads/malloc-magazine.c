@@ -0,0 +1,54 @@
+/* Allocates and frees blocks of every size class, many more
+   than fit in a magazine, in patterns that exercise magazine
+   refills and flushes, checking that no two live blocks
+   overlap. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/malloc.h"
+
+#define BLOCK_CNT 100
+#define ROUND_CNT 20
+
+void
+test_malloc_magazine (void) 
+{
+  static uint8_t *blocks[BLOCK_CNT];
+  size_t size;
+  int round, i;
+
+  for (size = 8; size <= 2048; size *= 2)
+    for (round = 0; round < ROUND_CNT; round++)
+      {
+        for (i = 0; i < BLOCK_CNT; i++)
+          {
+            blocks[i] = malloc (size);
+            if (blocks[i] == NULL)
+              fail ("malloc (%zu) failed", size);
+            memset (blocks[i], i, size);
+          }
+        for (i = 0; i < BLOCK_CNT; i++)
+          if (blocks[i][0] != i || blocks[i][size - 1] != i)
+            fail ("%zu-byte block %d overwritten", size, i);
+
+        /* Free every other block, reallocate them, then free
+           all. */
+        for (i = 0; i < BLOCK_CNT; i += 2)
+          free (blocks[i]);
+        for (i = 0; i < BLOCK_CNT; i += 2)
+          {
+            blocks[i] = malloc (size);
+            if (blocks[i] == NULL)
+              fail ("malloc (%zu) failed", size);
+            memset (blocks[i], i, size);
+          }
+        for (i = 1; i < BLOCK_CNT; i += 2)
+          if (blocks[i][0] != i || blocks[i][size - 1] != i)
+            fail ("%zu-byte block %d overwritten", size, i);
+        for (i = 0; i < BLOCK_CNT; i++)
+          free (blocks[i]);
+      }
+  msg ("all sizes allocated and freed");
+  pass ();
+}
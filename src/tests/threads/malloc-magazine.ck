@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(malloc-magazine) begin
+(malloc-magazine) all sizes allocated and freed
+(malloc-magazine) PASS
+(malloc-magazine) end
+EOF
+pass;
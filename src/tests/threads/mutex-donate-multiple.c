@@ -0,0 +1,75 @@
+/* The main thread acquires mutexes A and B, then it creates two
+   higher-priority threads.  Each of these threads blocks
+   acquiring one of the mutexes and thus donates its priority to
+   the main thread.  The main thread releases the mutexes in turn
+   and must keep the donation from A after giving up B.
+
+   Same shape as priority-donate-multiple, but exercises the
+   per-thread donation records used by struct mutex. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func a_thread_func;
+static thread_func b_thread_func;
+
+void
+test_mutex_donate_multiple (void) 
+{
+  struct mutex a, b;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  mutex_init (&a);
+  mutex_init (&b);
+
+  mutex_acquire (&a);
+  mutex_acquire (&b);
+
+  thread_create ("a", PRI_DEFAULT + 1, a_thread_func, &a);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 1, thread_get_priority ());
+
+  thread_create ("b", PRI_DEFAULT + 2, b_thread_func, &b);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 2, thread_get_priority ());
+
+  mutex_release (&b);
+  msg ("Thread b should have just finished.");
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 1, thread_get_priority ());
+
+  mutex_release (&a);
+  msg ("Thread a should have just finished.");
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT, thread_get_priority ());
+}
+
+static void
+a_thread_func (void *mutex_) 
+{
+  struct mutex *mutex = mutex_;
+
+  mutex_acquire (mutex);
+  msg ("Thread a acquired mutex a.");
+  mutex_release (mutex);
+  msg ("Thread a finished.");
+}
+
+static void
+b_thread_func (void *mutex_) 
+{
+  struct mutex *mutex = mutex_;
+
+  mutex_acquire (mutex);
+  msg ("Thread b acquired mutex b.");
+  mutex_release (mutex);
+  msg ("Thread b finished.");
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(mutex-donate-multiple) begin
+(mutex-donate-multiple) Main thread should have priority 32.  Actual priority: 32.
+(mutex-donate-multiple) Main thread should have priority 33.  Actual priority: 33.
+(mutex-donate-multiple) Thread b acquired mutex b.
+(mutex-donate-multiple) Thread b finished.
+(mutex-donate-multiple) Thread b should have just finished.
+(mutex-donate-multiple) Main thread should have priority 32.  Actual priority: 32.
+(mutex-donate-multiple) Thread a acquired mutex a.
+(mutex-donate-multiple) Thread a finished.
+(mutex-donate-multiple) Thread a should have just finished.
+(mutex-donate-multiple) Main thread should have priority 31.  Actual priority: 31.
+(mutex-donate-multiple) end
+EOF
+pass;
@@ -0,0 +1,62 @@
+/* Allocates blocks of many different sizes from the kernel pool,
+   checks that they do not overlap, frees them in an order that
+   interleaves neighbors, and then checks that the freed memory
+   has been coalesced enough to satisfy a large request again. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+#define BLOCK_CNT 48
+#define BIG_PAGES 64
+
+void
+test_palloc_buddy (void) 
+{
+  uint8_t *blocks[BLOCK_CNT];
+  size_t sizes[BLOCK_CNT];
+  uint8_t *big;
+  int i, parity;
+
+  /* Make sure a large block is available to begin with. */
+  big = palloc_get_multiple (0, BIG_PAGES);
+  if (big == NULL)
+    fail ("initial %d-page allocation failed", BIG_PAGES);
+  palloc_free_multiple (big, BIG_PAGES);
+
+  for (i = 0; i < BLOCK_CNT; i++)
+    {
+      /* Sizes 1 through 7 pages, including non-powers of 2. */
+      sizes[i] = i % 7 + 1;
+      blocks[i] = palloc_get_multiple (0, sizes[i]);
+      if (blocks[i] == NULL)
+        fail ("allocation %d of %zu pages failed", i, sizes[i]);
+      memset (blocks[i], i, sizes[i] * PGSIZE);
+    }
+
+  for (i = 0; i < BLOCK_CNT; i++)
+    {
+      size_t j;
+      for (j = 0; j < sizes[i] * PGSIZE; j += PGSIZE / 4)
+        if (blocks[i][j] != i)
+          fail ("block %d overwritten at offset %zu", i, j);
+    }
+  msg ("allocated %d blocks without overlap", BLOCK_CNT);
+
+  /* Free even-numbered blocks, then odd-numbered ones. */
+  for (parity = 0; parity < 2; parity++)
+    for (i = parity; i < BLOCK_CNT; i += 2)
+      palloc_free_multiple (blocks[i], sizes[i]);
+
+  big = palloc_get_multiple (PAL_ZERO, BIG_PAGES);
+  if (big == NULL)
+    fail ("%d-page allocation failed after frees", BIG_PAGES);
+  for (i = 0; i < BIG_PAGES * PGSIZE; i += PGSIZE)
+    if (big[i] != 0)
+      fail ("PAL_ZERO block not zeroed at offset %d", i);
+  palloc_free_multiple (big, BIG_PAGES);
+  msg ("freed memory coalesced");
+  pass ();
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(palloc-buddy) begin
+(palloc-buddy) allocated 48 blocks without overlap
+(palloc-buddy) freed memory coalesced
+(palloc-buddy) PASS
+(palloc-buddy) end
+EOF
+pass;
@@ -0,0 +1,86 @@
+/* Creates an object cache with a constructor, allocates enough
+   objects to span several slabs, and checks that every object
+   was constructed exactly once, that objects do not overlap, and
+   that freed objects come back still constructed, without being
+   constructed again, when they are reused. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/slab.h"
+
+#define OBJ_CNT 64
+
+/* Stored by the constructor. */
+#define CTOR_MAGIC 0x7e57c702
+
+/* An odd-sized object, to exercise exact-size packing. */
+struct test_obj
+  {
+    unsigned magic;             /* CTOR_MAGIC once constructed. */
+    int ctor_cnt;               /* Times constructed. */
+    int id;                     /* Owner, while allocated. */
+    char pad[519];
+  };
+
+/* Total constructor calls. */
+static int ctor_cnt;
+
+static kmem_ctor_func test_obj_ctor;
+
+void
+test_slab_cache (void) 
+{
+  static struct test_obj *objs[OBJ_CNT];
+  struct kmem_cache *cache;
+  int round, i;
+
+  cache = kmem_cache_create ("test_obj", sizeof (struct test_obj),
+                             test_obj_ctor);
+  for (round = 0; round < 2; round++)
+    {
+      for (i = 0; i < OBJ_CNT; i++)
+        {
+          objs[i] = kmem_cache_alloc (cache);
+          if (objs[i] == NULL)
+            fail ("allocation %d failed", i);
+          if (objs[i]->magic != CTOR_MAGIC)
+            fail ("object %d not constructed", i);
+          if (objs[i]->ctor_cnt != 1)
+            fail ("object %d constructed %d times", i, objs[i]->ctor_cnt);
+          objs[i]->id = i;
+          memset (objs[i]->pad, i, sizeof objs[i]->pad);
+        }
+      for (i = 0; i < OBJ_CNT; i++)
+        if (objs[i]->id != i
+            || objs[i]->pad[0] != i
+            || objs[i]->pad[sizeof objs[i]->pad - 1] != i)
+          fail ("object %d overwritten", i);
+      for (i = 0; i < OBJ_CNT; i++)
+        kmem_cache_free (cache, objs[i]);
+      msg ("round %d: %d objects allocated and freed", round, OBJ_CNT);
+    }
+  if (ctor_cnt < OBJ_CNT)
+    fail ("%d constructor calls for %d objects", ctor_cnt, OBJ_CNT);
+  pass ();
+}
+
+/* Marks OBJ constructed and counts the call in OBJ and in
+   total.  A new slab's page comes from palloc, which fills freed
+   pages with 0xcc, so an object that has not been constructed
+   does not hold CTOR_MAGIC and a second construction of the same
+   object shows up as a count above 1. */
+static void
+test_obj_ctor (void *obj_) 
+{
+  struct test_obj *obj = obj_;
+
+  if (obj->magic == CTOR_MAGIC)
+    obj->ctor_cnt++;
+  else
+    {
+      obj->magic = CTOR_MAGIC;
+      obj->ctor_cnt = 1;
+    }
+  ctor_cnt++;
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(slab-cache) begin
+(slab-cache) round 0: 64 objects allocated and freed
+(slab-cache) round 1: 64 objects allocated and freed
+(slab-cache) PASS
+(slab-cache) end
+EOF
+pass;
@@ -38,6 +38,11 @@ static const struct test tests[] =
     {"mlfqs-nice-2", test_mlfqs_nice_2},
     {"mlfqs-nice-10", test_mlfqs_nice_10},
     {"mlfqs-block", test_mlfqs_block},
+    {"thread-create-exit", test_thread_create_exit},
+    {"palloc-buddy", test_palloc_buddy},
+    {"malloc-magazine", test_malloc_magazine},
+    {"slab-cache", test_slab_cache},
+    {"mutex-donate-multiple", test_mutex_donate_multiple},
   };
 
 static const char *test_name;
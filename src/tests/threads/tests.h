@@ -32,6 +32,11 @@ extern test_func test_mlfqs_fair_20;
 extern test_func test_mlfqs_nice_2;
 extern test_func test_mlfqs_nice_10;
 extern test_func test_mlfqs_block;
+extern test_func test_thread_create_exit;
+extern test_func test_palloc_buddy;
+extern test_func test_malloc_magazine;
+extern test_func test_slab_cache;
+extern test_func test_mutex_donate_multiple;
 
 void msg (const char *, ...);
 void fail (const char *, ...);
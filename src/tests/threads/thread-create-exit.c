@@ -0,0 +1,56 @@
+/* Measures thread creation and exit throughput.  The main thread
+   repeatedly creates a batch of higher-priority threads that
+   each exit at once, waiting for every batch to finish before
+   starting the next, and reports how many create/exit pairs
+   completed per timer tick.  Most threads after the first
+   batch should run on a recycled thread page. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define BATCH_CNT 8
+#define ROUND_CNT 256
+
+static thread_func exit_thread_func;
+
+void
+test_thread_create_exit (void) 
+{
+  struct semaphore done;
+  int64_t start, elapsed;
+  int round, i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&done, 0);
+  start = timer_ticks ();
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      for (i = 0; i < BATCH_CNT; i++)
+        if (thread_create ("exit", PRI_DEFAULT + 1,
+                           exit_thread_func, &done) == TID_ERROR)
+          fail ("thread_create failed in round %d", round);
+      for (i = 0; i < BATCH_CNT; i++)
+        sema_down (&done);
+    }
+  elapsed = timer_elapsed (start);
+
+  msg ("%d threads created and exited.", ROUND_CNT * BATCH_CNT);
+  printf ("thread-create-exit: %"PRId64" ticks, %"PRId64" threads/tick\n",
+          elapsed, elapsed > 0 ? ROUND_CNT * BATCH_CNT / elapsed : 0);
+  pass ();
+}
+
+static void
+exit_thread_func (void *done_) 
+{
+  struct semaphore *done = done_;
+
+  sema_up (done);
+}
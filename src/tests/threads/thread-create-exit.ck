@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing creation count in output"
+  unless grep ($_ eq '(thread-create-exit) 2048 threads created and exited.',
+               @output);
+fail "missing PASS in output"
+  unless grep ($_ eq '(thread-create-exit) PASS', @output);
+
+pass;
@@ -1,11 +1,11 @@
 /* Child process run by multi-child-fd test.
 
    Attempts to close the file descriptor passed as the first
-   command-line argument.  This is invalid, because file
-   descriptors are not inherited in Pintos.  Two results are
-   allowed: either the system call should return without taking
-   any action, or the kernel should terminate the process with a
-   -1 exit code. */
+   command-line argument.  Where descriptors are inherited across
+   exec() this closes only the child's copy; otherwise the
+   descriptor is invalid.  Two results are allowed: either the
+   system call should return normally, or the kernel should
+   terminate the process with a -1 exit code. */
 
 #include <ctype.h>
 #include <stdio.h>
@@ -0,0 +1,24 @@
+/* Child process run by pipe-exec test.
+   Reads its standard input, which the parent has redirected from
+   a pipe, until end of file and prints what it read. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+
+const char *test_name = "child-consumer";
+
+int
+main (void) 
+{
+  char buf[128];
+  int total = 0;
+  int n;
+
+  while ((n = read (STDIN_FILENO, buf + total, sizeof buf - total)) > 0)
+    total += n;
+  if (n < 0)
+    fail ("read() failed");
+  msg ("read \"%.*s\"", total, buf);
+  return 0;
+}
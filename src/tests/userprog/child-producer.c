@@ -0,0 +1,21 @@
+/* Child process run by pipe-exec test.
+   Writes a message to its standard output, which the parent has
+   redirected into a pipe, and terminates. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+
+const char *test_name = "child-producer";
+
+static const char message[] = "sent through a pipe";
+
+int
+main (void) 
+{
+  if (write (STDOUT_FILENO, message, strlen (message))
+      != (int) strlen (message))
+    return 1;
+  return 0;
+}
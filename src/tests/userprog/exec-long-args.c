@@ -0,0 +1,42 @@
+/* Executes a child with far more arguments than fit in a small
+   fixed-size table, then tries one whose arguments cannot fit in
+   a page at all, and one whose command line is itself longer
+   than a page.  Both must fail cleanly, without killing the
+   caller. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char cmd_line[8192];
+
+/* Builds "child-simple x x x ..." with ARG_CNT arguments. */
+static void
+build_cmd_line (int arg_cnt) 
+{
+  char *p;
+  int i;
+
+  strlcpy (cmd_line, "child-simple", sizeof cmd_line);
+  p = cmd_line + strlen (cmd_line);
+  for (i = 0; i < arg_cnt; i++) 
+    {
+      *p++ = ' ';
+      *p++ = 'x';
+    }
+  *p = '\0';
+}
+
+void
+test_main (void) 
+{
+  build_cmd_line (600);
+  msg ("wait(exec()) = %d", wait (exec (cmd_line)));
+
+  build_cmd_line (1000);
+  msg ("exec() = %d", exec (cmd_line));
+
+  build_cmd_line (3000);
+  msg ("exec() = %d", exec (cmd_line));
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(exec-long-args) begin
+(child-simple) run
+child-simple: exit(81)
+(exec-long-args) wait(exec()) = 81
+(exec-long-args) exec() = -1
+(exec-long-args) exec() = -1
+(exec-long-args) end
+exec-long-args: exit(0)
+EOF
+pass;
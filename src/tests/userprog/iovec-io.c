@@ -0,0 +1,50 @@
+/* Gathers a header and a payload into a file with writev(),
+   scatters them back out with readv(), and uses pread() and
+   pwrite() to access the middle of the file without moving the
+   file position. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char header[] = "HEADER:";
+static char payload[] = "the quick brown fox";
+
+void
+test_main (void) 
+{
+  struct iovec iov[2];
+  char head_buf[sizeof header - 1];
+  char body_buf[sizeof payload - 1];
+  char word[5];
+  int total = sizeof header - 1 + sizeof payload - 1;
+  int handle;
+
+  CHECK (create ("iovec", 0), "create \"iovec\"");
+  CHECK ((handle = open ("iovec")) > 1, "open \"iovec\"");
+
+  iov[0].iov_base = header;
+  iov[0].iov_len = sizeof header - 1;
+  iov[1].iov_base = payload;
+  iov[1].iov_len = sizeof payload - 1;
+  CHECK (writev (handle, iov, 2) == total, "writev %d bytes", total);
+  CHECK (tell (handle) == (unsigned) total, "position is %d", total);
+
+  CHECK (pread (handle, word, 5, 11) == 5, "pread 5 bytes at 11");
+  if (memcmp (word, "quick", 5))
+    fail ("pread returned \"%.5s\"", word);
+  CHECK (pwrite (handle, "QUICK", 5, 11) == 5, "pwrite 5 bytes at 11");
+  CHECK (tell (handle) == (unsigned) total, "position is still %d", total);
+
+  seek (handle, 0);
+  iov[0].iov_base = head_buf;
+  iov[1].iov_base = body_buf;
+  CHECK (readv (handle, iov, 2) == total, "readv %d bytes", total);
+  if (memcmp (head_buf, header, sizeof head_buf))
+    fail ("header is \"%.*s\"", (int) sizeof head_buf, head_buf);
+  if (memcmp (body_buf, "the QUICK brown fox", sizeof body_buf))
+    fail ("payload is \"%.*s\"", (int) sizeof body_buf, body_buf);
+  msg ("readv data matches");
+  close (handle);
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(iovec-io) begin
+(iovec-io) create "iovec"
+(iovec-io) open "iovec"
+(iovec-io) writev 26 bytes
+(iovec-io) position is 26
+(iovec-io) pread 5 bytes at 11
+(iovec-io) pwrite 5 bytes at 11
+(iovec-io) position is still 26
+(iovec-io) readv 26 bytes
+(iovec-io) readv data matches
+(iovec-io) end
+iovec-io: exit(0)
+EOF
+pass;
@@ -0,0 +1,32 @@
+/* Opens the same file many times, more than fit in a process's
+   initial descriptor table, then closes one descriptor and
+   checks that the next open reuses it, since open() must return
+   the lowest free descriptor. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define OPEN_CNT 100
+
+void
+test_main (void) 
+{
+  int handles[OPEN_CNT];
+  int i;
+
+  for (i = 0; i < OPEN_CNT; i++)
+    {
+      handles[i] = open ("sample.txt");
+      if (handles[i] < 2)
+        fail ("open #%d returned %d", i, handles[i]);
+      if (i > 0 && handles[i] != handles[i - 1] + 1)
+        fail ("open #%d returned %d after %d", i, handles[i], handles[i - 1]);
+    }
+  msg ("opened \"sample.txt\" %d times", OPEN_CNT);
+
+  msg ("close handle %d", handles[OPEN_CNT / 2]);
+  close (handles[OPEN_CNT / 2]);
+  CHECK (open ("sample.txt") == handles[OPEN_CNT / 2],
+         "reopen reuses the closed handle");
+}
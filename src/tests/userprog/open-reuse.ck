@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(open-reuse) begin
+(open-reuse) opened "sample.txt" 100 times
+(open-reuse) close handle 52
+(open-reuse) reopen reuses the closed handle
+(open-reuse) end
+open-reuse: exit(0)
+EOF
+pass;
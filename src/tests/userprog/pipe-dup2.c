@@ -0,0 +1,34 @@
+/* Passes data through a pipe, redirects standard output into it
+   with dup2() and back to the console by closing it, and checks
+   that the read end sees end of file once the write end is
+   closed. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int fds[2];
+  char buf[64];
+  int n;
+
+  CHECK (pipe (fds), "pipe");
+  CHECK (write (fds[1], "hello", 5) == 5, "write \"hello\"");
+  n = read (fds[0], buf, sizeof buf);
+  msg ("read \"%.*s\"", n, buf);
+
+  if (dup2 (fds[1], STDOUT_FILENO) != STDOUT_FILENO)
+    fail ("dup2() to stdout failed");
+  write (STDOUT_FILENO, "redirected", 10);
+  close (STDOUT_FILENO);
+  msg ("closed stdout");
+  n = read (fds[0], buf, sizeof buf);
+  msg ("read \"%.*s\"", n, buf);
+
+  close (fds[1]);
+  msg ("closed write end");
+  msg ("read at end of file returns %d", read (fds[0], buf, sizeof buf));
+}
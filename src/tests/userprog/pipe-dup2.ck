@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-dup2) begin
+(pipe-dup2) pipe
+(pipe-dup2) write "hello"
+(pipe-dup2) read "hello"
+(pipe-dup2) closed stdout
+(pipe-dup2) read "redirected"
+(pipe-dup2) closed write end
+(pipe-dup2) read at end of file returns 0
+(pipe-dup2) end
+pipe-dup2: exit(0)
+EOF
+pass;
@@ -0,0 +1,42 @@
+/* Connects two child processes with a pipe: runs child-producer
+   with its standard output redirected into the pipe and
+   child-consumer with its standard input redirected from it.
+   Both children get the pipe only by inheriting the parent's
+   descriptors across exec(). */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int fds[2];
+  pid_t producer, consumer;
+
+  CHECK (pipe (fds), "pipe");
+
+  /* While stdout is redirected, msg() would write into the pipe,
+     so report failures only after restoring the console. */
+  if (dup2 (fds[1], STDOUT_FILENO) != STDOUT_FILENO)
+    fail ("dup2() to stdout failed");
+  producer = exec ("child-producer");
+  close (STDOUT_FILENO);
+  close (fds[1]);
+  if (producer == PID_ERROR)
+    fail ("exec(\"child-producer\") failed");
+
+  /* The consumer must not inherit a write end, or it would never
+     see end of file. */
+  if (dup2 (fds[0], STDIN_FILENO) != STDIN_FILENO)
+    fail ("dup2() to stdin failed");
+  close (fds[0]);
+  consumer = exec ("child-consumer");
+  close (STDIN_FILENO);
+  if (consumer == PID_ERROR)
+    fail ("exec(\"child-consumer\") failed");
+
+  msg ("wait(consumer) = %d", wait (consumer));
+  msg ("wait(producer) = %d", wait (producer));
+}
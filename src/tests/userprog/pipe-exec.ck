@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-exec) begin
+(pipe-exec) pipe
+child-producer: exit(0)
+(child-consumer) read "sent through a pipe"
+child-consumer: exit(0)
+(pipe-exec) wait(consumer) = 0
+(pipe-exec) wait(producer) = 0
+(pipe-exec) end
+pipe-exec: exit(0)
+EOF
+pass;
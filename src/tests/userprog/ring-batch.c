@@ -0,0 +1,77 @@
+/* Issues a batch of file operations through a submission ring:
+   opens "sample.txt", then, with a single ring_enter(), reads
+   part of it, seeks back, reads the same part again, writes a
+   line to the console, and closes the file, checking every
+   completion. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static struct ring ring;
+static char buf1[16], buf2[16];
+static char line[] = "written through the ring\n";
+
+/* Queues operation OP and returns its submission entry. */
+static struct ring_sqe *
+submit (int op, int fd, unsigned user_data) 
+{
+  struct ring_sqe *sqe = &ring.sq[ring.sq_tail++ % RING_ENTRIES];
+  sqe->op = op;
+  sqe->fd = fd;
+  sqe->user_data = user_data;
+  return sqe;
+}
+
+/* Removes the next completion, checks that it belongs to
+   USER_DATA, and returns its result. */
+static int
+complete (unsigned user_data) 
+{
+  struct ring_cqe *cqe;
+
+  if (ring.cq_head == ring.cq_tail)
+    fail ("no completion for operation %u", user_data);
+  cqe = &ring.cq[ring.cq_head++ % RING_ENTRIES];
+  if (cqe->user_data != user_data)
+    fail ("completion for %u, expected %u", cqe->user_data, user_data);
+  return cqe->res;
+}
+
+void
+test_main (void) 
+{
+  struct ring_sqe *sqe;
+  int handle;
+
+  CHECK (ring_setup (&ring), "ring_setup");
+
+  submit (RING_OPEN, 0, 1)->buf = "sample.txt";
+  CHECK (ring_enter () == 1, "submit open");
+  CHECK ((handle = complete (1)) > 1, "open \"sample.txt\"");
+
+  sqe = submit (RING_READ, handle, 2);
+  sqe->buf = buf1;
+  sqe->len = sizeof buf1;
+  submit (RING_SEEK, handle, 3)->ofs = 0;
+  sqe = submit (RING_READ, handle, 4);
+  sqe->buf = buf2;
+  sqe->len = sizeof buf2;
+  sqe = submit (RING_WRITE, STDOUT_FILENO, 5);
+  sqe->buf = line;
+  sqe->len = sizeof line - 1;
+  submit (RING_CLOSE, handle, 6);
+  CHECK (ring_enter () == 5, "submit batch of 5");
+
+  CHECK (complete (2) == sizeof buf1, "read %zu bytes", sizeof buf1);
+  CHECK (complete (3) == 0, "seek to 0");
+  CHECK (complete (4) == sizeof buf2, "read %zu bytes", sizeof buf2);
+  CHECK (complete (5) == sizeof line - 1, "write to console");
+  CHECK (complete (6) == 0, "close");
+  if (memcmp (buf1, sample, sizeof buf1) || memcmp (buf2, sample, sizeof buf2))
+    fail ("data read does not match sample.txt");
+  msg ("data matches");
+}
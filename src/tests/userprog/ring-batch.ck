@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(ring-batch) begin
+(ring-batch) ring_setup
+(ring-batch) submit open
+(ring-batch) open "sample.txt"
+written through the ring
+(ring-batch) submit batch of 5
+(ring-batch) read 16 bytes
+(ring-batch) seek to 0
+(ring-batch) read 16 bytes
+(ring-batch) write to console
+(ring-batch) close
+(ring-batch) data matches
+(ring-batch) end
+ring-batch: exit(0)
+EOF
+pass;
@@ -0,0 +1,13 @@
+/* Tests the sched_trace system call, which prints the kernel's
+   scheduler trace and per-thread scheduler statistics. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  sched_trace ();
+  msg ("sched_trace returned");
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+fail "missing scheduler trace\n"
+  if !grep (/^Scheduler trace: last \d+ of \d+ switches$/, @output);
+fail "missing thread scheduler statistics\n"
+  if !grep ($_ eq 'Thread scheduler statistics (TSC cycles):', @output);
+fail "missing 'sched_trace returned' message\n"
+  if !grep ($_ eq '(sched-trace) sched_trace returned', @output);
+pass;
@@ -0,0 +1,38 @@
+/* Writes a buffer larger than the kernel pins at once to a file
+   in a single write(), then reads it back in a single read() and
+   checks that every byte survived the round trip. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define BUF_SIZE 80000
+
+static char buf[BUF_SIZE];
+
+void
+test_main (void) 
+{
+  int handle;
+  size_t i;
+
+  for (i = 0; i < BUF_SIZE; i++)
+    buf[i] = i % 251;
+
+  CHECK (create ("large", 0), "create \"large\"");
+  CHECK ((handle = open ("large")) > 1, "open \"large\"");
+  if (write (handle, buf, BUF_SIZE) != BUF_SIZE)
+    fail ("write() did not write %d bytes", BUF_SIZE);
+  msg ("wrote %d bytes", BUF_SIZE);
+
+  memset (buf, 0, BUF_SIZE);
+  seek (handle, 0);
+  if (read (handle, buf, BUF_SIZE) != BUF_SIZE)
+    fail ("read() did not read %d bytes", BUF_SIZE);
+  for (i = 0; i < BUF_SIZE; i++)
+    if (buf[i] != (char) (i % 251))
+      fail ("byte %zu is %d, expected %d", i, buf[i], (int) (i % 251));
+  msg ("read back %d bytes", BUF_SIZE);
+  close (handle);
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(write-large) begin
+(write-large) create "large"
+(write-large) open "large"
+(write-large) wrote 80000 bytes
+(write-large) read back 80000 bytes
+(write-large) end
+write-large: exit(0)
+EOF
+pass;
@@ -0,0 +1,42 @@
+/* Forks a child that checks it sees the parent's data and then
+   overwrites it, and checks that the parent's copy is not
+   affected by the child's writes. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (2 * 4096)
+
+static char buf[SIZE];
+
+/* Returns true if every byte of BUF is C. */
+static bool
+all_equal (char c) 
+{
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != c)
+      return false;
+  return true;
+}
+
+void
+test_main (void) 
+{
+  pid_t pid;
+
+  memset (buf, 'a', SIZE);
+  msg ("fork");
+  pid = fork ();
+  if (pid == 0)
+    {
+      bool saw_parent = all_equal ('a');
+      memset (buf, 'b', SIZE);
+      exit (saw_parent && all_equal ('b') ? 81 : 1);
+    }
+  CHECK (wait (pid) == 81, "wait for child");
+  CHECK (all_equal ('a'), "parent's copy unchanged");
+}
@@ -0,0 +1,287 @@
+#include "threads/cpu.h"
+#include <debug.h>
+#include <packed.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/loader.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Per-CPU state.
+
+   Each CPU has its own run queue and idle thread.  A thread
+   that becomes ready is queued on the run queue of the CPU that
+   readied it; a CPU whose own queue is empty steals the
+   highest-priority thread from the busiest other queue before
+   falling back to its idle thread.  The CPU a thread is running
+   on is recorded in its `cpu' member, which the scheduler
+   updates on every switch, so cpu_current() costs no more than
+   thread_current().
+
+   CPUs are enumerated from the MultiProcessor Specification
+   tables left in memory by the BIOS (QEMU builds them according
+   to its -smp option).  Only the bootstrap processor is started:
+   application processors are recorded but left halted, so
+   CPU_CNT, the number of CPUs actually scheduling threads, is
+   1.  Starting them needs local APIC and IOAPIC setup and a
+   kernel whose intr_disable() critical sections have all been
+   converted to locks; until then this file is the scheduler
+   side of that work.  See [MPS] for the table formats. */
+
+struct cpu cpus[CPU_MAX];
+
+/* Number of started CPUs. */
+unsigned cpu_cnt;
+
+/* Number of CPUs described by the BIOS. */
+static unsigned cpu_detected_cnt;
+
+/* MP floating pointer structure.  See [MPS] 4.1. */
+struct mp_float
+  {
+    char signature[4];                  /* "_MP_". */
+    uint32_t config_paddr;              /* Physical address of config table. */
+    uint8_t length;                     /* Length in 16-byte units. */
+    uint8_t spec_rev;                   /* Specification revision. */
+    uint8_t checksum;                   /* All bytes must sum to 0. */
+    uint8_t features[5];                /* Feature bytes. */
+  }
+PACKED;
+
+/* MP configuration table header.  See [MPS] 4.2. */
+struct mp_config
+  {
+    char signature[4];                  /* "PCMP". */
+    uint16_t length;                    /* Length of base table. */
+    uint8_t spec_rev;                   /* Specification revision. */
+    uint8_t checksum;                   /* All bytes must sum to 0. */
+    char oem_id[8];
+    char product_id[12];
+    uint32_t oem_table_paddr;
+    uint16_t oem_table_size;
+    uint16_t entry_cnt;                 /* Number of entries that follow. */
+    uint32_t lapic_paddr;               /* Local APIC base address. */
+    uint16_t ext_length;
+    uint8_t ext_checksum;
+    uint8_t reserved;
+  }
+PACKED;
+
+/* MP configuration table processor entry.  See [MPS] 4.3.1. */
+struct mp_processor
+  {
+    uint8_t type;                       /* MP_PROCESSOR. */
+    uint8_t apic_id;                    /* Local APIC ID. */
+    uint8_t apic_version;
+    uint8_t flags;                      /* MP_CPU_* flags. */
+    uint32_t signature;
+    uint32_t features;
+    uint32_t reserved[2];
+  }
+PACKED;
+
+/* MP configuration table entry types and their sizes. */
+#define MP_PROCESSOR 0
+#define MP_PROCESSOR_SIZE 20
+#define MP_OTHER_SIZE 8
+
+/* Processor entry flags. */
+#define MP_CPU_ENABLED 0x01             /* Processor is usable. */
+#define MP_CPU_BSP 0x02                 /* Bootstrap processor. */
+
+static void init_cpu (struct cpu *, unsigned id, uint8_t apic_id);
+static struct mp_float *mp_search (uintptr_t paddr, size_t size);
+static bool mp_checksum (const void *, size_t size);
+static void mp_parse (const struct mp_config *);
+
+/* Sets up the bootstrap processor's state and enumerates the
+   other CPUs in the system.  Called by thread_init() with
+   interrupts off, before any thread has been created. */
+void
+cpu_init (void)
+{
+  struct mp_float *mpf;
+  uint16_t ebda_seg;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  init_cpu (&cpus[0], 0, 0);
+  cpus[0].started = true;
+  cpu_cnt = 1;
+  cpu_detected_cnt = 1;
+
+  /* Search the first kB of the EBDA, the last kB of base
+     memory, and the BIOS ROM, in that order. */
+  ebda_seg = *(uint16_t *) ptov (0x40e);
+  mpf = NULL;
+  if (ebda_seg != 0)
+    mpf = mp_search ((uintptr_t) ebda_seg << 4, 1024);
+  if (mpf == NULL)
+    mpf = mp_search (0x9fc00, 1024);
+  if (mpf == NULL)
+    mpf = mp_search (0xf0000, 0x10000);
+
+  if (mpf != NULL && mpf->config_paddr != 0
+      && mpf->config_paddr < 1024 * 1024)
+    {
+      const struct mp_config *mpc = ptov (mpf->config_paddr);
+      if (!memcmp (mpc->signature, "PCMP", 4)
+          && mp_checksum (mpc, mpc->length))
+        mp_parse (mpc);
+    }
+}
+
+/* Returns the CPU that the running thread is on. */
+struct cpu *
+cpu_current (void)
+{
+  return thread_current ()->cpu;
+}
+
+/* Returns the bootstrap processor. */
+struct cpu *
+cpu_bsp (void)
+{
+  return &cpus[0];
+}
+
+/* Prints per-CPU statistics. */
+void
+cpu_print_stats (void)
+{
+  unsigned i;
+
+  printf ("CPU: %u detected, %u started\n", cpu_detected_cnt, cpu_cnt);
+  if (cpu_cnt > 1)
+    for (i = 0; i < cpu_cnt; i++)
+      printf ("CPU %u: %lld idle ticks, %lld kernel ticks, "
+              "%lld user ticks, %lld steals\n",
+              i, cpus[i].idle_ticks, cpus[i].kernel_ticks,
+              cpus[i].user_ticks, cpus[i].steal_cnt);
+}
+
+/* Adds T to RQ, after any threads of the same or higher
+   priority. */
+void
+runqueue_push (struct runqueue *rq, struct thread *t)
+{
+  spinlock_acquire (&rq->lock);
+  thread_push_priority (&rq->ready_list, &t->elem);
+  rq->ready_cnt++;
+  spinlock_release (&rq->lock);
+}
+
+/* Removes and returns the highest-priority thread in RQ, or a
+   null pointer if RQ is empty. */
+struct thread *
+runqueue_pop (struct runqueue *rq)
+{
+  struct thread *t = NULL;
+
+  spinlock_acquire (&rq->lock);
+  if (!list_empty (&rq->ready_list))
+    {
+      t = list_entry (list_pop_front (&rq->ready_list), struct thread, elem);
+      rq->ready_cnt--;
+    }
+  spinlock_release (&rq->lock);
+  return t;
+}
+
+/* Returns the priority of the highest-priority thread in RQ, or
+   PRI_MIN - 1 if RQ is empty. */
+int
+runqueue_max_priority (struct runqueue *rq)
+{
+  int priority = PRI_MIN - 1;
+
+  spinlock_acquire (&rq->lock);
+  if (!list_empty (&rq->ready_list))
+    priority = get_thread_priority (list_entry (list_front (&rq->ready_list),
+                                                struct thread, elem));
+  spinlock_release (&rq->lock);
+  return priority;
+}
+
+/* Returns the number of ready threads on all CPUs' run queues. */
+size_t
+cpu_ready_cnt (void)
+{
+  size_t cnt = 0;
+  unsigned i;
+
+  for (i = 0; i < cpu_cnt; i++)
+    cnt += cpus[i].rq.ready_cnt;
+  return cnt;
+}
+
+/* Initializes C as CPU number ID with the given local APIC ID. */
+static void
+init_cpu (struct cpu *c, unsigned id, uint8_t apic_id)
+{
+  memset (c, 0, sizeof *c);
+  c->id = id;
+  c->apic_id = apic_id;
+  spinlock_init (&c->rq.lock);
+  list_init (&c->rq.ready_list);
+}
+
+/* Looks for an MP floating pointer structure in the SIZE bytes
+   of physical memory starting at PADDR. */
+static struct mp_float *
+mp_search (uintptr_t paddr, size_t size)
+{
+  uint8_t *p = ptov (paddr);
+  uint8_t *end = p + size;
+
+  for (; p + sizeof (struct mp_float) <= end; p += sizeof (struct mp_float))
+    if (!memcmp (p, "_MP_", 4) && mp_checksum (p, sizeof (struct mp_float)))
+      return (struct mp_float *) p;
+  return NULL;
+}
+
+/* Returns true if the SIZE bytes at P sum to 0. */
+static bool
+mp_checksum (const void *p_, size_t size)
+{
+  const uint8_t *p = p_;
+  uint8_t sum = 0;
+
+  while (size-- > 0)
+    sum += *p++;
+  return sum == 0;
+}
+
+/* Records the processors listed in MPC.  The bootstrap processor
+   keeps index 0; the others get the following indexes but are
+   not started. */
+static void
+mp_parse (const struct mp_config *mpc)
+{
+  const uint8_t *p = (const uint8_t *) (mpc + 1);
+  const uint8_t *end = (const uint8_t *) mpc + mpc->length;
+  unsigned ap_cnt = 0;
+  unsigned i;
+
+  for (i = 0; i < mpc->entry_cnt && p < end; i++)
+    if (*p == MP_PROCESSOR)
+      {
+        const struct mp_processor *proc = (const struct mp_processor *) p;
+        if (!(proc->flags & MP_CPU_ENABLED))
+          ;
+        else if (proc->flags & MP_CPU_BSP)
+          cpus[0].apic_id = proc->apic_id;
+        else
+          {
+            if (1 + ap_cnt < CPU_MAX)
+              init_cpu (&cpus[1 + ap_cnt], 1 + ap_cnt, proc->apic_id);
+            ap_cnt++;
+          }
+        p += MP_PROCESSOR_SIZE;
+      }
+    else
+      p += MP_OTHER_SIZE;
+
+  cpu_detected_cnt = 1 + ap_cnt;
+}
@@ -0,0 +1,95 @@
+#ifndef THREADS_CPU_H
+#define THREADS_CPU_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "threads/synch.h"
+
+/* Maximum number of CPUs we keep state for. */
+#define CPU_MAX 8
+
+/* A run queue: the threads in THREAD_READY state that a CPU will
+   run next, highest priority first. */
+struct runqueue
+  {
+    struct spinlock lock;               /* Protects the members below. */
+    struct list ready_list;             /* Ready threads, by priority. */
+    size_t ready_cnt;                   /* Number of threads on ready_list. */
+  };
+
+/* Per-CPU state. */
+struct cpu
+  {
+    unsigned id;                        /* Index into cpus[]. */
+    uint8_t apic_id;                    /* Local APIC ID. */
+    bool started;                       /* Is this CPU scheduling threads? */
+    struct thread *idle_thread;         /* This CPU's idle thread. */
+    struct runqueue rq;                 /* This CPU's run queue. */
+    unsigned thread_ticks;              /* # of timer ticks since last yield. */
+
+    /* Statistics. */
+    long long idle_ticks;               /* # of timer ticks spent idle. */
+    long long kernel_ticks;             /* # of timer ticks in kernel threads. */
+    long long user_ticks;               /* # of timer ticks in user programs. */
+    long long steal_cnt;                /* # of threads stolen from others. */
+  };
+
+extern struct cpu cpus[CPU_MAX];
+extern unsigned cpu_cnt;
+
+void cpu_init (void);
+struct cpu *cpu_current (void);
+struct cpu *cpu_bsp (void);
+void cpu_print_stats (void);
+
+/* Returns this CPU's time-stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint32_t lo, hi;
+
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+/* CPUID leaf 1 feature flags in EDX. */
+#define CPUID_PSE (1 << 3)              /* 4 MB pages. */
+#define CPUID_SEP (1 << 11)             /* SYSENTER and SYSEXIT. */
+#define CPUID_PGE (1 << 13)             /* Global pages. */
+
+/* CR4 control bits. */
+#define CR4_PSE 0x00000010              /* Enable 4 MB pages. */
+#define CR4_PGE 0x00000080              /* Enable global pages. */
+
+/* Returns the feature flags that CPUID leaf 1 reports in EDX. */
+static inline uint32_t
+cpuid_features (void)
+{
+  uint32_t a, b, c, d;
+
+  asm volatile ("cpuid" : "=a" (a), "=b" (b), "=c" (c), "=d" (d) : "a" (1));
+  return d;
+}
+
+/* Model-specific registers. */
+#define MSR_SYSENTER_CS 0x174           /* SYSENTER code segment. */
+#define MSR_SYSENTER_ESP 0x175          /* SYSENTER stack pointer. */
+#define MSR_SYSENTER_EIP 0x176          /* SYSENTER entry point. */
+
+/* Writes VALUE to model-specific register MSR. */
+static inline void
+wrmsr (uint32_t msr, uint64_t value)
+{
+  asm volatile ("wrmsr"
+                : : "c" (msr), "a" ((uint32_t) value),
+                    "d" ((uint32_t) (value >> 32)));
+}
+
+void runqueue_push (struct runqueue *, struct thread *);
+struct thread *runqueue_pop (struct runqueue *);
+int runqueue_max_priority (struct runqueue *);
+size_t cpu_ready_cnt (void);
+
+#endif /* threads/cpu.h */
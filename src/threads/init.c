@@ -15,19 +15,28 @@
 #include "devices/timer.h"
 #include "devices/vga.h"
 #include "devices/rtc.h"
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/sched-trace.h"
 #include "threads/thread.h"
+#include "threads/workqueue.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
+#include "userprog/execcache.h"
 #include "userprog/gdt.h"
 #include "userprog/syscall.h"
 #include "userprog/tss.h"
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+#endif
 #else
 #include "tests/threads/tests.h"
 #endif
@@ -113,8 +122,16 @@ main (void)
 #ifdef USERPROG
   exception_init ();
   syscall_init ();
+  exec_cache_init ();
+#endif
+#ifdef VM
+  page_init ();
+  frame_init ();
 #endif
 
+  /* Start worker threads for deferred work. */
+  workqueue_init ();
+
   /* Start thread scheduler and enable interrupts. */
   thread_start ();
   serial_init_queue ();
@@ -126,8 +143,13 @@ main (void)
   locate_block_devices ();
   filesys_init (format_filesys);
 #endif
+#ifdef VM
+  swap_init ();
+#endif
 
+#ifdef FILESYS
   thread_current ()->current_dir = ROOT_DIR_SECTOR;
+#endif
   printf ("Boot complete.\n");
   
   /* Run actions specified on kernel command line. */
@@ -154,13 +176,32 @@ bss_init (void)
 /* Populates the base page directory and page table with the
    kernel virtual mapping, and then sets up the CPU to use the
    new page directory.  Points init_page_dir to the page
-   directory it creates. */
+   directory it creates.
+
+   If the CPU supports 4 MB pages, each 4 MB-aligned run of
+   physical memory is mapped with a single page directory entry
+   instead of a page table of 1,024 entries, which multiplies
+   the kernel's TLB reach by 1,024 and saves the page tables.
+   The run holding the kernel's code is the exception: it keeps
+   4 kB pages so that the code can stay read-only.  If the CPU
+   supports global pages, the kernel's mappings are made global,
+   so that they stay in the TLB when a process switch reloads
+   CR3. */
 static void
 paging_init (void)
 {
   uint32_t *pd, *pt;
   size_t page;
   extern char _start, _end_kernel_text;
+  uint32_t features = cpuid_features ();
+  bool large = (features & CPUID_PSE) != 0;
+  uint32_t cr4;
+
+  if (large)
+    {
+      asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+      asm volatile ("movl %0, %%cr4" : : "r" (cr4 | CR4_PSE));
+    }
 
   pd = init_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
   pt = NULL;
@@ -172,13 +213,22 @@ paging_init (void)
       size_t pte_idx = pt_no (vaddr);
       bool in_kernel_text = &_start <= vaddr && vaddr < &_end_kernel_text;
 
+      if (large && pte_idx == 0
+          && init_ram_pages - page >= PTSPAN / PGSIZE
+          && (vaddr + PTSPAN <= &_start || vaddr >= &_end_kernel_text))
+        {
+          pd[pde_idx] = pde_create_large (vaddr);
+          page += PTSPAN / PGSIZE - 1;
+          continue;
+        }
+
       if (pd[pde_idx] == 0)
         {
           pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
           pd[pde_idx] = pde_create (pt);
         }
 
-      pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text);
+      pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text) | PTE_G;
     }
 
   /* Store the physical address of the page directory into CR3
@@ -187,6 +237,13 @@ paging_init (void)
      to/from Control Registers" and [IA32-v3a] 3.7.5 "Base Address
      of the Page Directory". */
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)));
+
+  /* Keep the kernel's mappings in the TLB across CR3 loads. */
+  if (features & CPUID_PGE)
+    {
+      asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+      asm volatile ("movl %0, %%cr4" : : "r" (cr4 | CR4_PGE));
+    }
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -252,11 +309,17 @@ parse_options (char **argv)
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
 #endif
+#endif
+#ifdef VM
+      else if (!strcmp (name, "-stack-max"))
+        page_stack_max = (size_t) atoi (value) * 1024;
 #endif
       else if (!strcmp (name, "-rs"))
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-sched-trace"))
+        sched_trace_at_shutdown = true;
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
@@ -380,8 +443,12 @@ usage (void)
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -sched-trace       Print scheduler trace and statistics at shutdown.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+          "  -stack-max=KB      Limit user stacks to KB kB (default 8192).\n"
 #endif
           );
   shutdown_power_off ();
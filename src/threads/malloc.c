@@ -5,6 +5,8 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -32,7 +34,34 @@
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.
+
+   In front of each descriptor's free list sits a magazine layer:
+   every CPU has, per descriptor, a small stack ("magazine") of
+   free blocks that it allocates from and frees to with
+   interrupts disabled, without taking the descriptor lock.  Only
+   when a magazine is empty (or full) do we lock the descriptor,
+   to move half a magazine's worth of blocks from (or to) the
+   shared free list in one go.  Blocks in magazines are counted
+   as in use by their arenas.
+
+   An arena whose blocks all become free is not given back right
+   away: each descriptor keeps up to ARENA_RETAIN such arenas
+   around, so that a loop that allocates and frees a block does
+   not get and free a page every time. */
+
+/* Number of free blocks a magazine can hold. */
+#define MAG_SIZE 16
+
+/* Number of entirely free arenas kept per descriptor. */
+#define ARENA_RETAIN 2
+
+/* A per-CPU cache of free blocks for one descriptor. */
+struct magazine
+  {
+    size_t cnt;                 /* Number of blocks in BLOCKS. */
+    struct block *blocks[MAG_SIZE]; /* Free blocks, top at CNT - 1. */
+  };
 
 /* Descriptor. */
 struct desc
@@ -40,7 +69,9 @@ struct desc
     size_t block_size;          /* Size of each element in bytes. */
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
     struct list free_list;      /* List of free blocks. */
-    struct lock lock;           /* Lock. */
+    size_t empty_arena_cnt;     /* Arenas with all blocks on free_list. */
+    struct mutex lock;          /* Lock. */
+    struct magazine mags[CPU_MAX]; /* Per-CPU magazines. */
   };
 
 /* Magic number for detecting arena corruption. */
@@ -64,8 +95,17 @@ struct block
 static struct desc descs[10];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Statistics. */
+static long long mag_hit_cnt;           /* # of mallocs served by magazines. */
+static long long mag_refill_cnt;        /* # of magazine refills. */
+static long long mag_flush_cnt;         /* # of magazine flushes. */
+static long long arena_alloc_cnt;       /* # of arenas obtained from palloc. */
+static long long arena_free_cnt;        /* # of arenas returned to palloc. */
+
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static struct block *depot_get (struct desc *);
+static void depot_put (struct desc *, struct block *);
 
 /* Initializes the malloc() descriptors. */
 void
@@ -80,7 +120,9 @@ malloc_init (void)
       d->block_size = block_size;
       d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
       list_init (&d->free_list);
-      lock_init (&d->lock);
+      d->empty_arena_cnt = 0;
+      mutex_init (&d->lock);
+      memset (d->mags, 0, sizeof d->mags);
     }
 }
 
@@ -92,6 +134,8 @@ malloc (size_t size)
   struct desc *d;
   struct block *b;
   struct arena *a;
+  struct magazine *mag;
+  enum intr_level old_level;
 
   /* A null pointer satisfies a request for 0 bytes. */
   if (size == 0)
@@ -119,37 +163,51 @@ malloc (size_t size)
       return a + 1;
     }
 
-  lock_acquire (&d->lock);
-
-  /* If the free list is empty, create a new arena. */
-  if (list_empty (&d->free_list))
+  /* Fast path: take a block from this CPU's magazine. */
+  old_level = intr_disable ();
+  mag = &d->mags[cpu_current ()->id];
+  if (mag->cnt > 0)
     {
-      size_t i;
-
-      /* Allocate a page. */
-      a = palloc_get_page (0);
-      if (a == NULL) 
-        {
-          lock_release (&d->lock);
-          return NULL; 
-        }
+      b = mag->blocks[--mag->cnt];
+      mag_hit_cnt++;
+      intr_set_level (old_level);
+      return b;
+    }
+  intr_set_level (old_level);
 
-      /* Initialize arena and add its blocks to the free list. */
-      a->magic = ARENA_MAGIC;
-      a->desc = d;
-      a->free_cnt = d->blocks_per_arena;
-      for (i = 0; i < d->blocks_per_arena; i++) 
+  /* Slow path: fill half the magazine from the free list, plus
+     one block to return. */
+  mutex_acquire (&d->lock);
+  b = depot_get (d);
+  if (b != NULL)
+    {
+      struct block *refill[MAG_SIZE / 2];
+      size_t refill_cnt = 0, i;
+
+      while (refill_cnt < MAG_SIZE / 2 
+             && (refill[refill_cnt] = depot_get (d)) != NULL)
+        refill_cnt++;
+      mutex_release (&d->lock);
+
+      /* We may have been preempted and migrated meanwhile, and
+         the magazine refilled or drained by someone else. */
+      old_level = intr_disable ();
+      mag = &d->mags[cpu_current ()->id];
+      mag_refill_cnt++;
+      for (i = 0; i < refill_cnt && mag->cnt < MAG_SIZE; i++)
+        mag->blocks[mag->cnt++] = refill[i];
+      intr_set_level (old_level);
+
+      if (i < refill_cnt)
         {
-          struct block *b = arena_to_block (a, i);
-          list_push_back (&d->free_list, &b->free_elem);
+          mutex_acquire (&d->lock);
+          for (; i < refill_cnt; i++)
+            depot_put (d, refill[i]);
+          mutex_release (&d->lock);
         }
     }
-
-  /* Get a block from free list and return it. */
-  b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
-  a = block_to_arena (b);
-  a->free_cnt--;
-  lock_release (&d->lock);
+  else
+    mutex_release (&d->lock);
   return b;
 }
 
@@ -223,6 +281,10 @@ free (void *p)
       struct block *b = p;
       struct arena *a = block_to_arena (b);
       struct desc *d = a->desc;
+      struct block *flush[MAG_SIZE / 2];
+      struct magazine *mag;
+      enum intr_level old_level;
+      size_t i;
       
       if (d != NULL) 
         {
@@ -233,26 +295,30 @@ free (void *p)
           memset (b, 0xcc, d->block_size);
 #endif
   
-          lock_acquire (&d->lock);
-
-          /* Add block to free list. */
-          list_push_front (&d->free_list, &b->free_elem);
-
-          /* If the arena is now entirely unused, free it. */
-          if (++a->free_cnt >= d->blocks_per_arena) 
+          /* Fast path: put the block in this CPU's magazine. */
+          old_level = intr_disable ();
+          mag = &d->mags[cpu_current ()->id];
+          if (mag->cnt < MAG_SIZE)
             {
-              size_t i;
-
-              ASSERT (a->free_cnt == d->blocks_per_arena);
-              for (i = 0; i < d->blocks_per_arena; i++) 
-                {
-                  struct block *b = arena_to_block (a, i);
-                  list_remove (&b->free_elem);
-                }
-              palloc_free_page (a);
+              mag->blocks[mag->cnt++] = b;
+              intr_set_level (old_level);
+              return;
             }
 
-          lock_release (&d->lock);
+          /* Slow path: the magazine is full.  Take out its older
+             half, to go back to the free list along with B. */
+          memcpy (flush, mag->blocks, sizeof flush);
+          mag->cnt -= MAG_SIZE / 2;
+          memmove (mag->blocks, mag->blocks + MAG_SIZE / 2,
+                   mag->cnt * sizeof *mag->blocks);
+          mag_flush_cnt++;
+          intr_set_level (old_level);
+
+          mutex_acquire (&d->lock);
+          for (i = 0; i < MAG_SIZE / 2; i++)
+            depot_put (d, flush[i]);
+          depot_put (d, b);
+          mutex_release (&d->lock);
         }
       else
         {
@@ -263,6 +329,93 @@ free (void *p)
     }
 }
 
+/* Prints allocator statistics. */
+void
+malloc_print_stats (void) 
+{
+  printf ("Malloc: %lld magazine hits, %lld refills, %lld flushes, "
+          "%lld arenas allocated, %lld released\n",
+          mag_hit_cnt, mag_refill_cnt, mag_flush_cnt,
+          arena_alloc_cnt, arena_free_cnt);
+}
+
+/* Removes and returns a block from D's free list, creating a new
+   arena if the list is empty.  Returns a null pointer if no
+   memory is available.  D's lock must be held. */
+static struct block *
+depot_get (struct desc *d) 
+{
+  struct block *b;
+  struct arena *a;
+
+  ASSERT (mutex_held_by_current_thread (&d->lock));
+
+  /* If the free list is empty, create a new arena. */
+  if (list_empty (&d->free_list))
+    {
+      size_t i;
+
+      /* Allocate a page. */
+      a = palloc_get_page (0);
+      if (a == NULL) 
+        return NULL; 
+      arena_alloc_cnt++;
+
+      /* Initialize arena and add its blocks to the free list. */
+      a->magic = ARENA_MAGIC;
+      a->desc = d;
+      a->free_cnt = d->blocks_per_arena;
+      for (i = 0; i < d->blocks_per_arena; i++) 
+        {
+          struct block *b = arena_to_block (a, i);
+          list_push_back (&d->free_list, &b->free_elem);
+        }
+      d->empty_arena_cnt++;
+    }
+
+  /* Get a block from free list and return it. */
+  b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
+  a = block_to_arena (b);
+  if (a->free_cnt-- == d->blocks_per_arena)
+    d->empty_arena_cnt--;
+  return b;
+}
+
+/* Adds block B to D's free list.  If that leaves B's arena
+   entirely unused and D already has ARENA_RETAIN unused arenas,
+   frees the arena.  D's lock must be held. */
+static void
+depot_put (struct desc *d, struct block *b) 
+{
+  struct arena *a = block_to_arena (b);
+
+  ASSERT (mutex_held_by_current_thread (&d->lock));
+
+  /* Add block to free list. */
+  list_push_front (&d->free_list, &b->free_elem);
+
+  /* If the arena is now entirely unused, free it, unless we are
+     keeping it. */
+  if (++a->free_cnt >= d->blocks_per_arena) 
+    {
+      size_t i;
+
+      ASSERT (a->free_cnt == d->blocks_per_arena);
+      if (d->empty_arena_cnt < ARENA_RETAIN)
+        {
+          d->empty_arena_cnt++;
+          return;
+        }
+      for (i = 0; i < d->blocks_per_arena; i++) 
+        {
+          struct block *b = arena_to_block (a, i);
+          list_remove (&b->free_elem);
+        }
+      palloc_free_page (a);
+      arena_free_cnt++;
+    }
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b)
@@ -2,6 +2,7 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -25,12 +26,45 @@
    half to the user pool.  That should be huge overkill for the
    kernel pool, but that's just fine for demonstration purposes. */
 
+/* Buddy allocation.
+
+   Each pool's pages are managed as a binary buddy system: free
+   memory is kept as blocks of 2**ORDER pages, aligned (relative
+   to the pool base) to their own size, on one free list per
+   order.  An allocation of N pages takes a block of the smallest
+   sufficient order, splitting a larger block if needed, then
+   gives back the unused tail of the block.  Freeing N pages
+   decomposes them into aligned blocks and merges each with its
+   buddy for as long as the buddy is also free.  Both take time
+   proportional to the number of orders, not to the size or
+   fullness of the pool.
+
+   Free blocks are linked through a list_elem stored in their
+   first page.  The order of each free block is recorded in a
+   byte per page, PAGE_ORDER, at the block's first page; all
+   other entries are 0.  A bitmap of allocated pages is kept as
+   well, to catch double frees. */
+
+/* Number of block orders: blocks are 1 to 2**(ORDER_CNT-1) pages. */
+#define ORDER_CNT 11
+
+/* PAGE_ORDER value for the first page of a free block of ORDER. */
+#define FREE_HEAD(ORDER) (0x80 | (ORDER))
+
 /* A memory pool. */
 struct pool
   {
-    struct lock lock;                   /* Mutual exclusion. */
-    struct bitmap *used_map;            /* Bitmap of free pages. */
+    struct spinlock lock;               /* Mutual exclusion. */
+    struct bitmap *used_map;            /* Bitmap of allocated pages. */
+    uint8_t *page_order;                /* Per-page FREE_HEAD or 0. */
+    struct list free_lists[ORDER_CNT];  /* Free blocks, by order. */
+    size_t free_cnt[ORDER_CNT];         /* Number of blocks on each list. */
+    size_t page_cnt;                    /* Number of pages in pool. */
     uint8_t *base;                      /* Base of pool. */
+
+    /* Statistics. */
+    long long split_cnt;                /* # of blocks split. */
+    long long merge_cnt;                /* # of buddy pairs merged. */
   };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -39,6 +73,9 @@ static struct pool kernel_pool, user_pool;
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static size_t buddy_alloc (struct pool *, size_t page_cnt);
+static void buddy_free_range (struct pool *, size_t page_idx, size_t page_cnt);
+static void print_pool_stats (const struct pool *, const char *name);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -77,9 +114,14 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
+  spinlock_acquire (&pool->lock);
+  page_idx = buddy_alloc (pool, page_cnt);
+  if (page_idx != BITMAP_ERROR)
+    {
+      ASSERT (bitmap_none (pool->used_map, page_idx, page_cnt));
+      bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+    }
+  spinlock_release (&pool->lock);
 
   if (page_idx != BITMAP_ERROR)
     pages = pool->base + PGSIZE * page_idx;
@@ -137,8 +179,11 @@ palloc_free_multiple (void *pages, size_t page_cnt)
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
+  spinlock_acquire (&pool->lock);
   ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
   bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  buddy_free_range (pool, page_idx, page_cnt);
+  spinlock_release (&pool->lock);
 }
 
 /* Frees the page at PAGE. */
@@ -148,15 +193,27 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Prints free memory and fragmentation statistics for both
+   pools. */
+void
+palloc_print_stats (void) 
+{
+  print_pool_stats (&kernel_pool, "kernel");
+  print_pool_stats (&user_pool, "user");
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
+  /* We'll put the pool's used_map and page_order array at its
+     base.  Calculate the space needed for them and subtract it
+     from the pool's size. */
+  size_t bm_size = bitmap_buf_size (page_cnt);
+  size_t bm_pages = DIV_ROUND_UP (bm_size + page_cnt, PGSIZE);
+  int order;
+
   if (bm_pages > page_cnt)
     PANIC ("Not enough memory in %s for bitmap.", name);
   page_cnt -= bm_pages;
@@ -164,9 +221,22 @@ init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
   /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
+  spinlock_init (&p->lock);
+  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_size);
+  p->page_order = (uint8_t *) base + bm_size;
+  memset (p->page_order, 0, page_cnt);
+  for (order = 0; order < ORDER_CNT; order++)
+    {
+      list_init (&p->free_lists[order]);
+      p->free_cnt[order] = 0;
+    }
+  p->page_cnt = page_cnt;
   p->base = base + bm_pages * PGSIZE;
+  p->split_cnt = p->merge_cnt = 0;
+
+  /* All pages start out free. */
+  buddy_free_range (p, 0, page_cnt);
+  p->merge_cnt = 0;
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -176,7 +246,137 @@ page_from_pool (const struct pool *pool, void *page)
 {
   size_t page_no = pg_no (page);
   size_t start_page = pg_no (pool->base);
-  size_t end_page = start_page + bitmap_size (pool->used_map);
+  size_t end_page = start_page + pool->page_cnt;
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Returns the list_elem stored in the first page of the block
+   at PAGE_IDX in POOL. */
+static struct list_elem *
+block_elem (const struct pool *pool, size_t page_idx) 
+{
+  return (struct list_elem *) (pool->base + PGSIZE * page_idx);
+}
+
+/* Adds the block of ORDER at PAGE_IDX to POOL's free lists. */
+static void
+push_free_block (struct pool *pool, size_t page_idx, int order) 
+{
+  pool->page_order[page_idx] = FREE_HEAD (order);
+  list_push_front (&pool->free_lists[order], block_elem (pool, page_idx));
+  pool->free_cnt[order]++;
+}
+
+/* Removes the free block of ORDER at PAGE_IDX from POOL's free
+   lists. */
+static void
+remove_free_block (struct pool *pool, size_t page_idx, int order) 
+{
+  ASSERT (pool->page_order[page_idx] == FREE_HEAD (order));
+  pool->page_order[page_idx] = 0;
+  list_remove (block_elem (pool, page_idx));
+  pool->free_cnt[order]--;
+}
+
+/* Frees the block of ORDER at PAGE_IDX in POOL, merging it with
+   its buddy as many times as possible. */
+static void
+buddy_free_block (struct pool *pool, size_t page_idx, int order) 
+{
+  while (order < ORDER_CNT - 1)
+    {
+      size_t buddy_idx = page_idx ^ ((size_t) 1 << order);
+      if (buddy_idx + ((size_t) 1 << order) > pool->page_cnt
+          || pool->page_order[buddy_idx] != FREE_HEAD (order))
+        break;
+      remove_free_block (pool, buddy_idx, order);
+      pool->merge_cnt++;
+      if (buddy_idx < page_idx)
+        page_idx = buddy_idx;
+      order++;
+    }
+  push_free_block (pool, page_idx, order);
+}
+
+/* Frees the PAGE_CNT pages starting at PAGE_IDX in POOL, as the
+   largest aligned blocks that the range can be divided into. */
+static void
+buddy_free_range (struct pool *pool, size_t page_idx, size_t page_cnt) 
+{
+  while (page_cnt > 0)
+    {
+      int order = 0;
+      while (order < ORDER_CNT - 1
+             && page_idx % ((size_t) 2 << order) == 0
+             && ((size_t) 2 << order) <= page_cnt)
+        order++;
+      buddy_free_block (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+    }
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL and returns the
+   index of the first, or BITMAP_ERROR if no free block is large
+   enough. */
+static size_t
+buddy_alloc (struct pool *pool, size_t page_cnt) 
+{
+  size_t page_idx;
+  int want, order;
+
+  for (want = 0; ((size_t) 1 << want) < page_cnt; want++)
+    if (want == ORDER_CNT - 1)
+      return BITMAP_ERROR;
+
+  for (order = want; order < ORDER_CNT; order++)
+    if (!list_empty (&pool->free_lists[order]))
+      break;
+  if (order == ORDER_CNT)
+    return BITMAP_ERROR;
+
+  page_idx = ((uint8_t *) list_front (&pool->free_lists[order])
+              - pool->base) / PGSIZE;
+  remove_free_block (pool, page_idx, order);
+
+  /* Split down to the wanted order, freeing upper halves. */
+  while (order > want)
+    {
+      order--;
+      push_free_block (pool, page_idx + ((size_t) 1 << order), order);
+      pool->split_cnt++;
+    }
+
+  /* Give back the unneeded tail of the block. */
+  buddy_free_range (pool, page_idx + page_cnt,
+                    ((size_t) 1 << want) - page_cnt);
+  return page_idx;
+}
+
+/* Prints statistics for POOL, named NAME. */
+static void
+print_pool_stats (const struct pool *pool, const char *name) 
+{
+  size_t free_pages = 0, largest = 0;
+  int order;
+
+  for (order = 0; order < ORDER_CNT; order++)
+    {
+      free_pages += pool->free_cnt[order] << order;
+      if (pool->free_cnt[order] > 0)
+        largest = (size_t) 1 << order;
+    }
+
+  /* External fragmentation: the share of free memory that is not
+     in the largest free block, in percent. */
+  printf ("Palloc: %s pool: %zu of %zu pages free, largest block %zu pages, "
+          "%zu%% fragmented, %lld splits, %lld merges\n",
+          name, free_pages, pool->page_cnt, largest,
+          free_pages > 0 ? 100 - largest * 100 / free_pages : 0,
+          pool->split_cnt, pool->merge_cnt);
+  printf ("Palloc: %s pool free blocks by order:", name);
+  for (order = 0; order < ORDER_CNT; order++)
+    printf (" %zu", pool->free_cnt[order]);
+  printf ("\n");
+}
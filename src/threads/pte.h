@@ -66,6 +66,8 @@ static inline uintptr_t pd_no (const void *va) {
 #define PTE_U 0x4               /* 1=user/kernel, 0=kernel only. */
 #define PTE_A 0x20              /* 1=accessed, 0=not acccessed. */
 #define PTE_D 0x40              /* 1=dirty, 0=not dirty (PTEs only). */
+#define PTE_PS 0x80             /* 1=4 MB page, 0=page table (PDEs only). */
+#define PTE_G 0x100             /* 1=global, kept across CR3 loads. */
 
 /* Returns a PDE that points to page table PT. */
 static inline uint32_t pde_create (uint32_t *pt) {
@@ -73,6 +75,14 @@ static inline uint32_t pde_create (uint32_t *pt) {
   return vtop (pt) | PTE_U | PTE_P | PTE_W;
 }
 
+/* Returns a PDE that maps PAGE, which must be aligned on a 4 MB
+   boundary, as a single 4 MB page that is writable, global, and
+   usable only by the kernel.  Requires CR4.PSE. */
+static inline uint32_t pde_create_large (void *page) {
+  ASSERT (((uintptr_t) page & (PTSPAN - 1)) == 0);
+  return vtop (page) | PTE_PS | PTE_G | PTE_P | PTE_W;
+}
+
 /* Returns a pointer to the page table that page directory entry
    PDE, which must "present", points to. */
 static inline uint32_t *pde_get_pt (uint32_t pde) {
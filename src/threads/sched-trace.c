@@ -0,0 +1,116 @@
+#include "threads/sched-trace.h"
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Scheduler trace.
+
+   schedule() records every thread switch in a fixed-size ring
+   buffer, overwriting the oldest events once it is full.  Each
+   event is stamped with the TSC, so the gaps between a thread
+   becoming ready and running, or between switches, can be
+   measured far below timer-tick granularity.  Recording happens
+   with interrupts off and costs one rdtsc and a few stores, so
+   it is always enabled; only the dump is optional.
+
+   A switch away from a thread that blocked on a lock, mutex or
+   semaphore records that object, so that the trace shows which
+   one a high-priority thread was stuck behind.  The object
+   itself accumulates the cycles its waiters spent blocked, in
+   its `block_tsc' member. */
+
+/* Number of events kept.  Must be a power of 2. */
+#define TRACE_SIZE 256
+
+/* One thread switch. */
+struct sched_event
+  {
+    uint64_t tsc;                       /* Time of switch. */
+    tid_t prev;                         /* Thread switched away from. */
+    tid_t next;                         /* Thread switched to. */
+    uint8_t prev_status;                /* PREV's new state. */
+    uint8_t cpu;                        /* CPU switching. */
+    const void *wait_obj;               /* Lock, mutex or semaphore PREV
+                                           blocked on, or null. */
+  };
+
+static struct sched_event trace[TRACE_SIZE];
+static unsigned trace_head;             /* Total events ever recorded. */
+static int trace_frozen;                /* # of dumps in progress. */
+
+bool sched_trace_at_shutdown;
+
+/* Records a switch from PREV to NEXT.  Called by schedule() with
+   interrupts off. */
+void
+sched_trace_record (struct thread *prev, struct thread *next)
+{
+  struct sched_event *e;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (trace_frozen)
+    return;
+  e = &trace[trace_head++ % TRACE_SIZE];
+  e->tsc = next->stamp_tsc;
+  e->prev = prev->tid;
+  e->next = next->tid;
+  e->prev_status = prev->status;
+  e->cpu = prev->cpu->id;
+  e->wait_obj = NULL;
+  if (prev->status == THREAD_BLOCKED)
+    {
+      struct semaphore *sema = prev->waiting_for_semaphore;
+
+      if (prev->waiting_for_mutex != NULL)
+        e->wait_obj = prev->waiting_for_mutex;
+      else if (sema != NULL && prev->waiting_for_lock != NULL
+               && &prev->waiting_for_lock->semaphore == sema)
+        e->wait_obj = prev->waiting_for_lock;
+      else
+        e->wait_obj = sema;
+    }
+}
+
+/* Prints the trace, oldest event first, with times relative to
+   the oldest event, followed by per-thread scheduler
+   statistics.  Recording is suspended while the trace is printed,
+   since printing may itself switch threads. */
+void
+sched_trace_dump (void)
+{
+  static const char *status_names[] = {"run", "ready", "block", "exit"};
+  enum intr_level old_level;
+  unsigned head, cnt, i;
+  uint64_t base;
+
+  old_level = intr_disable ();
+  trace_frozen++;
+  head = trace_head;
+  intr_set_level (old_level);
+
+  cnt = head < TRACE_SIZE ? head : TRACE_SIZE;
+  base = trace[(head - cnt) % TRACE_SIZE].tsc;
+  printf ("Scheduler trace: last %u of %u switches\n", cnt, head);
+  for (i = 0; i < cnt; i++)
+    {
+      const struct sched_event *e = &trace[(head - cnt + i) % TRACE_SIZE];
+      printf ("  %10llu cpu%u %d -> %d (%s",
+              (unsigned long long) (e->tsc - base), e->cpu,
+              e->prev, e->next,
+              e->prev_status < 4 ? status_names[e->prev_status] : "?");
+      if (e->wait_obj != NULL)
+        printf (" on %p", e->wait_obj);
+      printf (")\n");
+    }
+
+  old_level = intr_disable ();
+  trace_frozen--;
+  intr_set_level (old_level);
+
+  thread_print_sched_stats ();
+}
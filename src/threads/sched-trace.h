@@ -0,0 +1,16 @@
+#ifndef THREADS_SCHED_TRACE_H
+#define THREADS_SCHED_TRACE_H
+
+#include <stdbool.h>
+
+struct thread;
+
+/* If true, the scheduler trace and per-thread scheduler
+   statistics are printed at shutdown.  Controlled by kernel
+   command-line option "-sched-trace". */
+extern bool sched_trace_at_shutdown;
+
+void sched_trace_record (struct thread *prev, struct thread *next);
+void sched_trace_dump (void);
+
+#endif /* threads/sched-trace.h */
@@ -0,0 +1,255 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Slab allocator.
+
+   A cache hands out objects of a single type.  Its memory comes
+   from the page allocator one page ("slab") at a time; each slab
+   starts with a struct slab header followed by as many objects as
+   fit, packed at their exact size rounded up to a word, instead
+   of the next power of 2 as with malloc().  A 530-byte object,
+   for example, takes 536 bytes here but 1024 from malloc().
+
+   If the cache has a constructor, it is run on every object of a
+   new slab.  Objects are expected to be back in their
+   constructed state when they are freed, so that the
+   constructor's work is not repeated on every allocation.  To
+   keep it intact, the free list link of each object is kept in
+   a word just past the object rather than inside it.
+
+   Slabs with free objects are kept on the cache's partial list,
+   and full slabs on its full list.  A slab whose objects all
+   become free goes back to the page allocator, unless it is the
+   cache's only such slab. */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* A cache of objects of one type. */
+struct kmem_cache
+  {
+    const char *name;           /* Name, for statistics. */
+    size_t obj_size;            /* Object size, rounded to a word. */
+    size_t stride;              /* Object size plus free link. */
+    size_t objs_per_slab;       /* Objects in each slab. */
+    kmem_ctor_func *ctor;       /* Constructor, or null. */
+    struct mutex lock;          /* Protects the members below. */
+    struct list partial;        /* Slabs with free objects. */
+    struct list full;           /* Slabs with no free objects. */
+    size_t empty_cnt;           /* Slabs on PARTIAL with no objects in use. */
+    size_t slab_cnt;            /* Total slabs. */
+    size_t inuse_cnt;           /* Objects allocated. */
+    long long alloc_cnt;        /* # of allocations. */
+    struct list_elem elem;      /* Element in cache_list. */
+  };
+
+/* Header at the start of each slab page. */
+struct slab
+  {
+    unsigned magic;             /* Always SLAB_MAGIC. */
+    struct kmem_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in partial or full list. */
+    void *free;                 /* First free object. */
+    size_t inuse;               /* Number of objects allocated. */
+  };
+
+/* All caches, for kmem_print_stats(). */
+static struct list cache_list = LIST_INITIALIZER (cache_list);
+
+static struct slab *slab_create (struct kmem_cache *);
+static void **free_link (struct kmem_cache *, void *obj);
+static struct slab *obj_to_slab (void *obj);
+
+/* Creates and returns a cache for objects of SIZE bytes, named
+   NAME.  If CTOR is non-null, it is called on each object before
+   the object is first allocated.  Panics if memory is not
+   available or SIZE is too big for a slab. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, kmem_ctor_func *ctor)
+{
+  struct kmem_cache *c;
+  enum intr_level old_level;
+
+  ASSERT (name != NULL);
+  ASSERT (size > 0);
+
+  c = malloc (sizeof *c);
+  if (c == NULL)
+    PANIC ("kmem_cache_create: out of memory");
+
+  c->name = name;
+  c->obj_size = ROUND_UP (size, sizeof (void *));
+  c->stride = c->obj_size + sizeof (void *);
+  c->objs_per_slab = (PGSIZE - sizeof (struct slab)) / c->stride;
+  if (c->objs_per_slab == 0)
+    PANIC ("kmem_cache_create: %zu-byte %s objects do not fit in a slab",
+           size, name);
+  c->ctor = ctor;
+  mutex_init (&c->lock);
+  list_init (&c->partial);
+  list_init (&c->full);
+  c->empty_cnt = 0;
+  c->slab_cnt = 0;
+  c->inuse_cnt = 0;
+  c->alloc_cnt = 0;
+
+  old_level = intr_disable ();
+  list_push_back (&cache_list, &c->elem);
+  intr_set_level (old_level);
+  return c;
+}
+
+/* Allocates and returns an object from cache C, or a null
+   pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c) 
+{
+  struct slab *s;
+  void *obj;
+
+  ASSERT (c != NULL);
+
+  mutex_acquire (&c->lock);
+  if (list_empty (&c->partial))
+    {
+      s = slab_create (c);
+      if (s == NULL)
+        {
+          mutex_release (&c->lock);
+          return NULL;
+        }
+      list_push_front (&c->partial, &s->elem);
+      c->empty_cnt++;
+    }
+  s = list_entry (list_front (&c->partial), struct slab, elem);
+
+  obj = s->free;
+  s->free = *free_link (c, obj);
+  if (s->inuse++ == 0)
+    c->empty_cnt--;
+  if (s->free == NULL)
+    {
+      list_remove (&s->elem);
+      list_push_front (&c->full, &s->elem);
+    }
+  c->inuse_cnt++;
+  c->alloc_cnt++;
+  mutex_release (&c->lock);
+
+  return obj;
+}
+
+/* Returns OBJ, which must have been allocated from cache C, to
+   C.  A null OBJ is ignored. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj) 
+{
+  struct slab *s;
+
+  if (obj == NULL)
+    return;
+
+  s = obj_to_slab (obj);
+  ASSERT (s->cache == c);
+  ASSERT (s->inuse > 0);
+
+  mutex_acquire (&c->lock);
+  if (s->free == NULL)
+    {
+      /* Was full: make it allocatable again. */
+      list_remove (&s->elem);
+      list_push_front (&c->partial, &s->elem);
+    }
+  *free_link (c, obj) = s->free;
+  s->free = obj;
+  c->inuse_cnt--;
+
+  if (--s->inuse == 0)
+    {
+      if (c->empty_cnt > 0)
+        {
+          list_remove (&s->elem);
+          c->slab_cnt--;
+          palloc_free_page (s);
+        }
+      else
+        c->empty_cnt++;
+    }
+  mutex_release (&c->lock);
+}
+
+/* Prints statistics for each cache. */
+void
+kmem_print_stats (void) 
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&cache_list); e != list_end (&cache_list);
+       e = list_next (e))
+    {
+      struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+      printf ("Slab %s: %zu-byte objects, %zu per slab, %zu slabs, "
+              "%zu in use, %lld allocations\n",
+              c->name, c->obj_size, c->objs_per_slab, c->slab_cnt,
+              c->inuse_cnt, c->alloc_cnt);
+    }
+}
+
+/* Gets a page from the page allocator and sets it up as a slab
+   for C, with all its objects free and constructed.  Returns a
+   null pointer if no page is available.  C's lock must be
+   held. */
+static struct slab *
+slab_create (struct kmem_cache *c) 
+{
+  struct slab *s = palloc_get_page (0);
+  uint8_t *obj;
+  size_t i;
+
+  if (s == NULL)
+    return NULL;
+  s->magic = SLAB_MAGIC;
+  s->cache = c;
+  s->inuse = 0;
+  s->free = NULL;
+
+  /* Link the objects in address order. */
+  obj = (uint8_t *) (s + 1) + c->stride * c->objs_per_slab;
+  for (i = 0; i < c->objs_per_slab; i++)
+    {
+      obj -= c->stride;
+      if (c->ctor != NULL)
+        c->ctor (obj);
+      *free_link (c, obj) = s->free;
+      s->free = obj;
+    }
+  c->slab_cnt++;
+  return s;
+}
+
+/* Returns the location of OBJ's free list link in cache C. */
+static void **
+free_link (struct kmem_cache *c, void *obj) 
+{
+  return (void **) ((uint8_t *) obj + c->obj_size);
+}
+
+/* Returns the slab that OBJ is in. */
+static struct slab *
+obj_to_slab (void *obj) 
+{
+  struct slab *s = pg_round_down (obj);
+
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT ((pg_ofs (obj) - sizeof *s) % s->cache->stride == 0);
+  return s;
+}
@@ -0,0 +1,18 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <stddef.h>
+
+/* Constructor for objects in a cache.  Called on each object
+   once, when the page holding it is added to the cache. */
+typedef void kmem_ctor_func (void *obj);
+
+struct kmem_cache;
+
+struct kmem_cache *kmem_cache_create (const char *name, size_t size,
+                                      kmem_ctor_func *);
+void *kmem_cache_alloc (struct kmem_cache *);
+void kmem_cache_free (struct kmem_cache *, void *);
+void kmem_print_stats (void);
+
+#endif /* threads/slab.h */
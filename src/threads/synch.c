@@ -29,10 +29,13 @@
 #include "threads/synch.h"
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/malloc.h"
 
+static int mutex_donation (struct thread *);
+
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
    manipulating it:
@@ -49,6 +52,7 @@ sema_init (struct semaphore *sema, unsigned value)
 
   sema->value = value;
   list_init (&sema->waiters);
+  sema->block_tsc = 0;
 }
 
 void
@@ -82,12 +86,16 @@ waiter_push_priority (struct list* list, struct list_elem *elem)
 void
 sema_down (struct semaphore *sema) 
 {
+  struct thread *cur = thread_current ();
   enum intr_level old_level;
+  uint64_t start = 0;
 
   ASSERT (sema != NULL);
   ASSERT (!intr_context ());
 
   old_level = intr_disable ();
+  if (sema->value == 0)
+    start = rdtsc ();
   while (sema->value == 0) 
     {
       //      waiter_push_priority (&sema->waiters, &thread_current ()->sema_elem);
@@ -95,6 +103,19 @@ sema_down (struct semaphore *sema)
       thread_current ()->waiting_for_semaphore = sema;
       thread_block ();
     }
+  if (start != 0)
+    {
+      /* Charge the wait to SEMA itself, which for a lock is the
+         lock's semaphore, and to the thread's lock or semaphore
+         total. */
+      uint64_t cycles = rdtsc () - start;
+      sema->block_tsc += cycles;
+      if (cur->waiting_for_lock != NULL
+          && &cur->waiting_for_lock->semaphore == sema)
+        cur->lock_block_tsc += cycles;
+      else
+        cur->sema_block_tsc += cycles;
+    }
   sema->value--;
   intr_set_level (old_level);
 }
@@ -250,6 +271,7 @@ donate (struct thread *from, struct thread *to, struct lock *lock)
   struct donate_priority *dp;
 
   dp = malloc (sizeof (struct donate_priority));
+  dp->mutex = NULL;
   dp->prev_priority = get_thread_priority(to);
   dp->donated_priority = get_thread_priority(from);
   dp->prev_donor = to->donated_by;
@@ -377,6 +399,11 @@ withdraw_donation (struct thread *of, struct lock *lock)
 	    }
 	}
     }
+
+  /* Donations through mutexes that OF still holds stay in
+     force. */
+  if (of->donated_priority < mutex_donation (of))
+    of->donated_priority = mutex_donation (of);
 }
 
 /* Releases LOCK, which must be owned by the current thread.
@@ -406,6 +433,331 @@ lock_held_by_current_thread (const struct lock *lock)
   return lock->holder == thread_current ();
 }
 
+/* Number of times mutex_acquire() spins waiting for a running
+   holder before it blocks. */
+#define MUTEX_SPIN_CNT 100
+
+/* Maximum number of threads along a chain of mutex holders that
+   a blocking thread donates its priority to. */
+#define MUTEX_DONATE_DEPTH 8
+
+/* Mutex statistics, summed over all mutexes. */
+static long long mutex_acquire_cnt;     /* # of acquisitions. */
+static long long mutex_contended_cnt;   /* # that found the mutex held. */
+static long long mutex_block_cnt;       /* # of times a waiter blocked. */
+
+/* Atomically compares *P against OLD and, if equal, stores NEW
+   into *P.  Returns the previous value of *P. */
+static inline int
+atomic_cmpxchg (int *p, int old, int new)
+{
+  int prev;
+  asm volatile ("lock cmpxchgl %2, %1"
+                : "=a" (prev), "+m" (*p)
+                : "r" (new), "0" (old)
+                : "memory");
+  return prev;
+}
+
+/* Atomically stores NEW into *P and returns the previous value
+   of *P. */
+static inline int
+atomic_xchg (int *p, int new)
+{
+  asm volatile ("xchgl %0, %1" : "+r" (new), "+m" (*p) : : "memory");
+  return new;
+}
+
+/* Initializes mutex M as free. */
+void
+mutex_init (struct mutex *m)
+{
+  ASSERT (m != NULL);
+
+  m->state = 0;
+  m->holder = NULL;
+  list_init (&m->waiters);
+  m->acquire_cnt = 0;
+  m->contended_cnt = 0;
+  m->block_tsc = 0;
+}
+
+/* Returns the highest priority donated to T through mutexes
+   that it holds, or 0 if there is none. */
+static int
+mutex_donation (struct thread *t)
+{
+  struct list_elem *e;
+  int priority = 0;
+
+  for (e = list_begin (&t->donate_list); e != list_end (&t->donate_list);
+       e = list_next (e))
+    {
+      struct donate_priority *dp = list_entry (e, struct donate_priority,
+                                               elem);
+      if (dp->mutex != NULL && (int) dp->donated_priority > priority)
+        priority = dp->donated_priority;
+    }
+  return priority;
+}
+
+/* Donates DONOR's priority to the holder of M, which DONOR is
+   about to block on, and then, for as long as each holder is
+   itself blocked on a mutex, to that mutex's holder, up to
+   MUTEX_DONATE_DEPTH threads in all.  Each donation is recorded
+   in the receiving thread's donation list, using a record from
+   RECORDS, so that it stays in force until the receiver releases
+   the mutex it was made through, however many other donations
+   come and go in the meantime.  RECORDS lives on DONOR's stack,
+   which is safe because DONOR cannot wake up until every holder
+   in the chain has released its mutex and with it the record.
+   Must be called with interrupts off. */
+static void
+mutex_donate (struct thread *donor, struct mutex *m,
+              struct donate_priority records[MUTEX_DONATE_DEPTH])
+{
+  int priority = get_thread_priority (donor);
+  int depth;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (depth = 0; depth < MUTEX_DONATE_DEPTH && m != NULL; depth++)
+    {
+      struct thread *holder = m->holder;
+      struct donate_priority *dp = &records[depth];
+
+      if (holder == NULL)
+        break;
+      dp->lock = NULL;
+      dp->mutex = m;
+      dp->prev_priority = holder->donated_priority;
+      dp->donated_priority = priority;
+      dp->donating_thread = donor;
+      dp->prev_donor = holder->donated_by;
+      list_push_front (&holder->donate_list, &dp->elem);
+      if (holder->donated_priority < priority)
+        holder->donated_priority = priority;
+      m = holder->waiting_for_mutex;
+    }
+}
+
+/* Withdraws every donation made to T through mutex M and
+   recomputes T's donated priority from the donations that
+   remain, whether through locks or other mutexes.  Must be
+   called with interrupts off. */
+static void
+mutex_withdraw (struct thread *t, struct mutex *m)
+{
+  struct list_elem *e, *next;
+  int priority = 0;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (e = list_begin (&t->donate_list); e != list_end (&t->donate_list);
+       e = next)
+    {
+      struct donate_priority *dp = list_entry (e, struct donate_priority,
+                                               elem);
+      next = list_next (e);
+      if (dp->mutex == m)
+        list_remove (e);
+      else if ((int) dp->donated_priority > priority)
+        priority = dp->donated_priority;
+    }
+  t->donated_priority = priority;
+}
+
+/* Returns true if thread A (on a mutex wait list) has lower
+   priority than thread B. */
+static bool
+mutex_waiter_less (const struct list_elem *a, const struct list_elem *b,
+                   void *aux UNUSED)
+{
+  return (get_thread_priority (list_entry (a, struct thread, sema_elem))
+          < get_thread_priority (list_entry (b, struct thread, sema_elem)));
+}
+
+/* Returns true if M's holder is currently running.  A holder
+   that is running will release the mutex soon, so waiting for it
+   by spinning is cheaper than blocking.  On a uniprocessor the
+   holder can never be running while we are, so this is always
+   false there and contended acquires go straight to blocking. */
+static bool
+mutex_holder_running (const struct mutex *m)
+{
+  struct thread *holder = m->holder;
+  return holder != NULL && holder->status == THREAD_RUNNING;
+}
+
+/* Acquires mutex M, sleeping until it becomes available if
+   necessary.  M must not already be held by the current thread.
+
+   The uncontended case neither disables interrupts nor blocks.
+   Under contention, the caller donates its priority to the
+   holder and sleeps, so this function must not be called within
+   an interrupt handler. */
+void
+mutex_acquire (struct mutex *m)
+{
+  struct thread *cur = thread_current ();
+  struct donate_priority records[MUTEX_DONATE_DEPTH];
+  enum intr_level old_level;
+  uint64_t start, cycles;
+  int spin;
+
+  ASSERT (m != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!mutex_held_by_current_thread (m));
+
+  if (atomic_cmpxchg (&m->state, 0, 1) != 0)
+    {
+      m->contended_cnt++;
+      mutex_contended_cnt++;
+
+      /* Spin phase. */
+      for (spin = 0; spin < MUTEX_SPIN_CNT && mutex_holder_running (m); spin++)
+        {
+          asm volatile ("pause" : : : "memory");
+          if (m->state == 0 && atomic_cmpxchg (&m->state, 0, 1) == 0)
+            goto acquired;
+        }
+
+      /* Block phase.  Setting STATE to 2 tells the holder that
+         mutex_release() must take the slow path and wake us. */
+      old_level = intr_disable ();
+      start = rdtsc ();
+      while (atomic_xchg (&m->state, 2) != 0)
+        {
+          mutex_donate (cur, m, records);
+          cur->waiting_for_mutex = m;
+          list_push_back (&m->waiters, &cur->sema_elem);
+          mutex_block_cnt++;
+          thread_block ();
+          cur->waiting_for_mutex = NULL;
+        }
+      cycles = rdtsc () - start;
+      m->block_tsc += cycles;
+      cur->lock_block_tsc += cycles;
+      intr_set_level (old_level);
+    }
+
+ acquired:
+  m->holder = cur;
+  m->acquire_cnt++;
+  mutex_acquire_cnt++;
+}
+
+/* Tries to acquire mutex M and returns true if successful or
+   false on failure.  Never sleeps or disables interrupts. */
+bool
+mutex_try_acquire (struct mutex *m)
+{
+  ASSERT (m != NULL);
+  ASSERT (!mutex_held_by_current_thread (m));
+
+  if (atomic_cmpxchg (&m->state, 0, 1) != 0)
+    return false;
+  m->holder = thread_current ();
+  m->acquire_cnt++;
+  mutex_acquire_cnt++;
+  return true;
+}
+
+/* Releases mutex M, which must be held by the current thread.
+   If any thread blocked on M, withdraws the donations made
+   through M, wakes the highest-priority waiter, and yields to it
+   if it now outranks the current thread. */
+void
+mutex_release (struct mutex *m)
+{
+  struct thread *cur = thread_current ();
+  struct thread *woken = NULL;
+  enum intr_level old_level;
+
+  ASSERT (m != NULL);
+  ASSERT (mutex_held_by_current_thread (m));
+
+  m->holder = NULL;
+  if (atomic_cmpxchg (&m->state, 1, 0) == 1)
+    return;
+
+  /* Contended: STATE was 2. */
+  old_level = intr_disable ();
+  mutex_withdraw (cur, m);
+  m->state = 0;
+  if (!list_empty (&m->waiters))
+    {
+      struct list_elem *e = list_max (&m->waiters, mutex_waiter_less, NULL);
+      list_remove (e);
+      woken = list_entry (e, struct thread, sema_elem);
+      thread_unblock (woken);
+    }
+  intr_set_level (old_level);
+
+  if (woken != NULL && get_thread_priority (woken) > thread_get_priority ())
+    thread_yield ();
+}
+
+/* Returns true if the current thread holds mutex M, false
+   otherwise. */
+bool
+mutex_held_by_current_thread (const struct mutex *m)
+{
+  ASSERT (m != NULL);
+
+  return m->holder == thread_current ();
+}
+
+/* Prints mutex statistics. */
+void
+mutex_print_stats (void)
+{
+  printf ("Mutex: %lld acquisitions, %lld contended, %lld blocked\n",
+          mutex_acquire_cnt, mutex_contended_cnt, mutex_block_cnt);
+}
+
+/* Initializes spinlock S as free. */
+void
+spinlock_init (struct spinlock *s)
+{
+  ASSERT (s != NULL);
+
+  s->locked = 0;
+  s->old_level = INTR_OFF;
+}
+
+/* Acquires spinlock S, disabling interrupts on this CPU and
+   busy-waiting until it is free.  May be called from an
+   interrupt handler. */
+void
+spinlock_acquire (struct spinlock *s)
+{
+  enum intr_level old_level;
+
+  ASSERT (s != NULL);
+
+  old_level = intr_disable ();
+  while (atomic_xchg (&s->locked, 1) != 0)
+    while (s->locked)
+      asm volatile ("pause" : : : "memory");
+  s->old_level = old_level;
+}
+
+/* Releases spinlock S and restores the interrupt level that was
+   in effect when it was acquired. */
+void
+spinlock_release (struct spinlock *s)
+{
+  enum intr_level old_level;
+
+  ASSERT (s != NULL);
+  ASSERT (s->locked);
+
+  old_level = s->old_level;
+  atomic_xchg (&s->locked, 0);
+  intr_set_level (old_level);
+}
+
 /* One semaphore in a list. */
 struct semaphore_elem 
   {
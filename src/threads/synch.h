@@ -3,17 +3,21 @@
 
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include "threads/interrupt.h"
 
 /* A counting semaphore. */
 struct semaphore 
   {
     unsigned value;             /* Current value. */
     struct list waiters;        /* List of waiting threads. */
+    uint64_t block_tsc;         /* TSC cycles threads spent blocked here. */
   };
 
 struct donate_priority
   {
     struct lock *lock;
+    struct mutex *mutex;        /* Mutex donated through, if LOCK is null. */
     unsigned prev_priority;
     unsigned donated_priority;
     struct thread *donating_thread;
@@ -40,6 +44,49 @@ bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
 
+/* Mutex.
+
+   A lock for short critical sections.  An uncontended acquire or
+   release is a single atomic instruction on STATE: it does not
+   disable interrupts or touch the waiter list.  Only when the
+   mutex is already held does the caller spin briefly (if the
+   holder is running) and then block, donating its priority to
+   the holder and, if the holder is itself blocked on a mutex, on
+   down the chain of holders. */
+struct mutex
+  {
+    int state;                  /* 0: free, 1: held, 2: held, maybe waiters. */
+    struct thread *holder;      /* Thread holding mutex. */
+    struct list waiters;        /* Threads blocked on the mutex. */
+    unsigned acquire_cnt;       /* # of acquisitions. */
+    unsigned contended_cnt;     /* # of acquisitions that found it held. */
+    uint64_t block_tsc;         /* TSC cycles threads spent blocked here. */
+  };
+
+void mutex_init (struct mutex *);
+void mutex_acquire (struct mutex *);
+bool mutex_try_acquire (struct mutex *);
+void mutex_release (struct mutex *);
+bool mutex_held_by_current_thread (const struct mutex *);
+void mutex_print_stats (void);
+
+/* Spinlock.
+
+   For data touched by interrupt handlers or by other CPUs, such
+   as run queues.  Acquiring a spinlock disables interrupts on
+   this CPU and then busy-waits until the lock word is free, so
+   the holder must never sleep and should hold it only for a few
+   instructions. */
+struct spinlock
+  {
+    int locked;                 /* 0: free, 1: held. */
+    enum intr_level old_level;  /* Interrupt level before acquire. */
+  };
+
+void spinlock_init (struct spinlock *);
+void spinlock_acquire (struct spinlock *);
+void spinlock_release (struct spinlock *);
+
 /* Condition variable. */
 struct condition 
   {
@@ -4,10 +4,12 @@
 #include <random.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
 #include "threads/palloc.h"
+#include "threads/sched-trace.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -21,22 +23,51 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
-
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
 //static struct list all_list;
 
-/* Idle thread. */
-static struct thread *idle_thread;
-
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
 
-/* Lock used by allocate_tid(). */
-static struct lock tid_lock;
+/* Next tid to hand out.  Incremented atomically by
+   allocate_tid(). */
+static tid_t next_tid = 1;
+
+/* Cache of pages released by dying threads, reused by
+   thread_create() so that creating a thread usually needs
+   neither the page allocator nor a 4 kB memset: only the
+   `struct thread' at the bottom of a recycled page is cleared,
+   by init_thread(), and the stack above it is simply
+   overwritten.  Cached pages are linked through their first
+   word. */
+#define THREAD_PAGE_CACHE_MAX 16
+struct thread_page
+  {
+    struct thread_page *next;   /* Next cached page. */
+  };
+static struct thread_page *thread_page_cache;
+static size_t thread_page_cache_cnt;
+static struct spinlock thread_page_cache_lock;
+static long long thread_page_reuse_cnt;  /* # of pages reused. */
+static long long thread_page_alloc_cnt;  /* # obtained from palloc. */
+
+/* Context switch statistics, over all threads. */
+static long long vol_switch_cnt;    /* # of switches not forced on the thread. */
+static long long invol_switch_cnt;  /* # of switches away from preempted threads. */
+
+/* Snapshot of one thread's scheduler statistics, taken by
+   thread_print_sched_stats() so that it can print without
+   holding off interrupts. */
+struct sched_stats
+  {
+    tid_t tid;
+    char name[16];
+    uint64_t run_tsc, ready_tsc, block_tsc, lock_block_tsc, sema_block_tsc;
+    unsigned vol_switches, invol_switches;
+  };
+#define SCHED_STATS_MAX 64
+static struct sched_stats sched_stats[SCHED_STATS_MAX];
 static struct lock main_lock;
 
 /* Stack frame for kernel_thread(). */
@@ -47,14 +78,8 @@ struct kernel_thread_frame
     void *aux;                  /* Auxiliary data for function. */
   };
 
-/* Statistics. */
-static long long idle_ticks;    /* # of timer ticks spent idle. */
-static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
-static long long user_ticks;    /* # of timer ticks in user programs. */
-
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
-static unsigned thread_ticks;   /* # of timer ticks since last yield. */
 
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
@@ -65,20 +90,25 @@ static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
 static struct thread *running_thread (void);
-static struct thread *next_thread_to_run (void);
+static struct thread *next_thread_to_run (struct cpu *);
+static bool is_idle_thread (struct thread *);
 static void init_thread (struct thread *, const char *name, int priority);
 static bool is_thread (struct thread *) UNUSED;
 static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
+static void yield (bool preempted);
 void thread_schedule_tail (struct thread *prev);
+static void account_state_change (struct thread *, uint64_t *);
 static tid_t allocate_tid (void);
+static void *thread_page_get (void);
+static void thread_page_put (void *);
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
    general and it is possible in this case only because loader.S
    was careful to put the bottom of the stack at a page boundary.
 
-   Also initializes the run queue and the tid lock.
+   Also initializes the per-CPU run queues and the tid lock.
 
    After calling this function, be sure to initialize the page
    allocator before trying to create any threads with
@@ -91,24 +121,26 @@ thread_init (void)
 {
   ASSERT (intr_get_level () == INTR_OFF);
 
-  lock_init (&tid_lock);
+  spinlock_init (&thread_page_cache_lock);
   lock_init (&main_lock);
-  list_init (&ready_list);
   list_init (&all_list);
+  cpu_init ();
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
   init_thread (initial_thread, "main", PRI_DEFAULT);
+  initial_thread->cpu = cpu_bsp ();
   initial_thread->status = THREAD_RUNNING;
   list_init (&initial_thread->donate_list);
   initial_thread->waiting_for_lock = NULL;
+  initial_thread->waiting_for_mutex = NULL;
   initial_thread->waiting_for_semaphore = NULL;
   initial_thread->donated_by = NULL;
   initial_thread->tid = allocate_tid ();
 }
 
 /* Starts preemptive thread scheduling by enabling interrupts.
-   Also creates the idle thread. */
+   Also creates the bootstrap processor's idle thread. */
 void
 thread_start (void) 
 {
@@ -139,21 +171,22 @@ void
 thread_tick (void) 
 {
   struct thread *t = thread_current ();
+  struct cpu *c = t->cpu;
   struct list_elem *e;
   struct thread *thread;
   int ready_threads;
 
   /* Update statistics. */
-  if (t == idle_thread)
-    idle_ticks++;
+  if (t == c->idle_thread)
+    c->idle_ticks++;
 #ifdef USERPROG
   else if (t->pagedir != NULL)
-    user_ticks++;
+    c->user_ticks++;
 #endif
   else
-    kernel_ticks++;
+    c->kernel_ticks++;
 
-  if (t != idle_thread)
+  if (t != c->idle_thread)
     t->recent_cpu = add_integer (t->recent_cpu, 1);
 
   if (timer_ticks () % 4 == 0 && thread_mlfqs)
@@ -162,7 +195,7 @@ thread_tick (void)
 	   e = list_next (e))
 	{
 	  thread = list_entry (e, struct thread, allelem);
-	  if (thread != idle_thread)
+	  if (!is_idle_thread (thread))
 	    thread->priority = calculate_new_priority (thread);
 	}
     }
@@ -170,8 +203,8 @@ thread_tick (void)
   if (timer_ticks () % TIMER_FREQ == 0
       && thread_mlfqs)
     {
-      ready_threads = list_size (&ready_list);
-      if (t != idle_thread)
+      ready_threads = cpu_ready_cnt ();
+      if (t != c->idle_thread)
 	ready_threads++;
 
       load_avg = add (mul (div (fixed (59), fixed (60)), load_avg),
@@ -189,7 +222,7 @@ thread_tick (void)
 	}
     }
   /* Enforce preemption. */
-  if (++thread_ticks >= TIME_SLICE)
+  if (++c->thread_ticks >= TIME_SLICE)
     intr_yield_on_return ();
 }
 
@@ -197,8 +230,74 @@ thread_tick (void)
 void
 thread_print_stats (void) 
 {
+  long long idle_ticks = 0, kernel_ticks = 0, user_ticks = 0;
+  unsigned i;
+
+  for (i = 0; i < cpu_cnt; i++)
+    {
+      idle_ticks += cpus[i].idle_ticks;
+      kernel_ticks += cpus[i].kernel_ticks;
+      user_ticks += cpus[i].user_ticks;
+    }
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
           idle_ticks, kernel_ticks, user_ticks);
+  printf ("Thread: %lld pages allocated, %lld pages reused\n",
+          thread_page_alloc_cnt, thread_page_reuse_cnt);
+  printf ("Thread: %lld voluntary, %lld involuntary switches\n",
+          vol_switch_cnt, invol_switch_cnt);
+  cpu_print_stats ();
+}
+
+/* Prints each live thread's scheduler statistics, in TSC
+   cycles. */
+void
+thread_print_sched_stats (void) 
+{
+  enum intr_level old_level;
+  struct list_elem *e;
+  size_t cnt = 0, i;
+
+  old_level = intr_disable ();
+  for (e = list_begin (&all_list);
+       e != list_end (&all_list) && cnt < SCHED_STATS_MAX; e = list_next (e))
+    {
+      struct thread *t = list_entry (e, struct thread, allelem);
+      struct sched_stats *s = &sched_stats[cnt++];
+      uint64_t now = rdtsc ();
+
+      s->tid = t->tid;
+      strlcpy (s->name, t->name, sizeof s->name);
+      s->run_tsc = t->run_tsc;
+      s->ready_tsc = t->ready_tsc;
+      s->block_tsc = t->block_tsc;
+      s->lock_block_tsc = t->lock_block_tsc;
+      s->sema_block_tsc = t->sema_block_tsc;
+      s->vol_switches = t->vol_switches;
+      s->invol_switches = t->invol_switches;
+
+      /* Charge the time since the last switch to the current
+         state. */
+      if (t->status == THREAD_RUNNING)
+        s->run_tsc += now - t->stamp_tsc;
+      else if (t->status == THREAD_READY)
+        s->ready_tsc += now - t->stamp_tsc;
+      else if (t->status == THREAD_BLOCKED)
+        s->block_tsc += now - t->stamp_tsc;
+    }
+  intr_set_level (old_level);
+
+  printf ("Thread scheduler statistics (TSC cycles):\n");
+  printf ("  %5s %-15s %12s %12s %12s %12s %12s %6s %6s\n",
+          "tid", "name", "run", "ready", "blocked", "on locks", "on semas",
+          "vol", "invol");
+  for (i = 0; i < cnt; i++)
+    {
+      const struct sched_stats *s = &sched_stats[i];
+      printf ("  %5d %-15s %12llu %12llu %12llu %12llu %12llu %6u %6u\n",
+              s->tid, s->name, s->run_tsc, s->ready_tsc, s->block_tsc,
+              s->lock_block_tsc, s->sema_block_tsc,
+              s->vol_switches, s->invol_switches);
+    }
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -229,7 +328,7 @@ thread_create (const char *name, int priority,
   ASSERT (function != NULL);
 
   /* Allocate thread. */
-  t = palloc_get_page (PAL_ZERO);
+  t = thread_page_get ();
   if (t == NULL)
     return TID_ERROR;
 
@@ -253,18 +352,15 @@ thread_create (const char *name, int priority,
   sf->ebp = 0;
 
   list_init (&(t->donate_list));
-  list_init (&(t->file_descriptors));
-  list_init (&(t->dir_descriptors));
   t->waiting_for_lock = NULL;
+  t->waiting_for_mutex = NULL;
   t->waiting_for_semaphore = NULL;
   t->donated_by = NULL;
   t->nice = thread_get_nice ();
   t->recent_cpu = thread_get_recent_cpu ();
   t->current_dir = thread_current ()->current_dir;
+  t->cpu = thread_current ()->cpu;
 
-  sema_init (&t->one, 0);
-  sema_init (&t->two, 0);
-  sema_init (&t->load, 0);
   /* Add to run queue. */
   thread_unblock (t);
   return tid;
@@ -318,7 +414,8 @@ print_list (struct list *list)
   printf("\n");
 
 }
-/* Transitions a blocked thread T to the ready-to-run state.
+/* Transitions a blocked thread T to the ready-to-run state,
+   queueing it on the current CPU's run queue.
    This is an error if T is not blocked.  (Use thread_yield() to
    make the running thread ready.)
 
@@ -334,13 +431,14 @@ thread_unblock (struct thread *t)
   ASSERT (is_thread (t));
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  thread_push_priority (&ready_list, &t->elem);
   t->status = THREAD_READY;
+  account_state_change (t, &t->block_tsc);
+  runqueue_push (&running_thread ()->cpu->rq, t);
   
   intr_set_level (old_level);
 
   if (thread_get_priority () < get_thread_priority(t) 
-      && thread_current () != idle_thread)
+      && !is_idle_thread (thread_current ()))
     {
       if (!intr_context ())
 	{
@@ -400,7 +498,6 @@ thread_exit (void)
      when it calls thread_schedule_tail(). */
   intr_disable ();
   list_remove (&thread_current()->allelem);
-  sema_up (&thread_current()->one);
   thread_current ()->status = THREAD_DYING;
   schedule ();
   NOT_REACHED ();
@@ -410,15 +507,34 @@ thread_exit (void)
    may be scheduled again immediately at the scheduler's whim. */
 void
 thread_yield (void) 
+{
+  yield (false);
+}
+
+/* Like thread_yield(), but counts the switch as involuntary.
+   Called by the interrupt handler when a handler has requested
+   preemption with intr_yield_on_return(). */
+void
+thread_preempt (void) 
+{
+  yield (true);
+}
+
+/* Puts the current thread back on its run queue and schedules.
+   PREEMPTED says whether the switch was forced on the thread
+   rather than requested by it. */
+static void
+yield (bool preempted) 
 {
   struct thread *cur = thread_current ();
   enum intr_level old_level;
 
   ASSERT (!intr_context ());
   old_level = intr_disable ();
-  if (cur != idle_thread) 
-      thread_push_priority (&ready_list, &cur->elem);
   cur->status = THREAD_READY;
+  if (!is_idle_thread (cur)) 
+    runqueue_push (&cur->cpu->rq, cur);
+  cur->preempted = preempted;
   schedule ();
   intr_set_level (old_level);
 }
@@ -445,15 +561,14 @@ void
 thread_set_priority (int new_priority) 
 {
   
-  struct thread * ready_list_head, * current_thread;
+  struct thread *current_thread;
+  enum intr_level old_level;
 
   current_thread = thread_current();
-  ready_list_head = list_entry (list_begin (&ready_list), struct thread, elem);
-  enum intr_level old_level;
   old_level = intr_disable ();
   current_thread->priority = new_priority;
   intr_set_level (old_level);
-  if (ready_list_head->priority > new_priority) 
+  if (runqueue_max_priority (&current_thread->cpu->rq) > new_priority) 
       thread_yield ();
 }
 
@@ -482,11 +597,9 @@ get_thread_priority (struct thread *t)
 void
 thread_set_nice (int new_nice) 
 {
-  struct thread * ready_list_head;
-
   thread_current ()->nice = new_nice;
 
-  if (thread_current () != idle_thread)
+  if (!is_idle_thread (thread_current ()))
     thread_current ()->priority = calculate_new_priority (thread_current ());
 }
 
@@ -512,19 +625,21 @@ thread_get_recent_cpu (void)
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
+   Each CPU has its own.
 
    The idle thread is initially put on the ready list by
    thread_start().  It will be scheduled once initially, at which
-   point it initializes idle_thread, "up"s the semaphore passed
-   to it to enable thread_start() to continue, and immediately
-   blocks.  After that, the idle thread never appears in the
-   ready list.  It is returned by next_thread_to_run() as a
-   special case when the ready list is empty. */
+   point it initializes its CPU's idle_thread, "up"s the
+   semaphore passed to it to enable thread_start() to continue,
+   and immediately blocks.  After that, the idle thread never
+   appears in a ready list.  It is returned by
+   next_thread_to_run() as a special case when there is no ready
+   thread to run or steal. */
 static void
 idle (void *idle_started_ UNUSED) 
 {
   struct semaphore *idle_started = idle_started_;
-  idle_thread = thread_current ();
+  thread_current ()->cpu->idle_thread = thread_current ();
   sema_up (idle_started);
 
   for (;;) 
@@ -574,6 +689,13 @@ running_thread (void)
   return pg_round_down (esp);
 }
 
+/* Returns true if T is some CPU's idle thread. */
+static bool
+is_idle_thread (struct thread *t)
+{
+  return t->cpu != NULL && t == t->cpu->idle_thread;
+}
+
 /* Returns true if T appears to point to a valid thread. */
 static bool
 is_thread (struct thread *t)
@@ -600,6 +722,11 @@ init_thread (struct thread *t, const char *name, int priority)
   t->nice = 0;
   t->recent_cpu = 0;
   t->magic = THREAD_MAGIC;
+  t->stamp_tsc = rdtsc ();
+#ifdef USERPROG
+  t->exit_status = -1;
+  list_init (&t->children);
+#endif
   old_level = intr_disable ();
   list_push_back (&all_list, &t->allelem);
   intr_set_level (old_level);
@@ -618,18 +745,38 @@ alloc_frame (struct thread *t, size_t size)
   return t->stack;
 }
 
-/* Chooses and returns the next thread to be scheduled.  Should
-   return a thread from the run queue, unless the run queue is
+/* Chooses and returns the next thread for CPU C to run.  Should
+   return a thread from C's run queue, unless that queue is
    empty.  (If the running thread can continue running, then it
-   will be in the run queue.)  If the run queue is empty, return
-   idle_thread. */
+   will be in the run queue.)  Otherwise, steals the first thread
+   from the longest run queue of another CPU.  If there is
+   nothing to steal either, returns C's idle thread. */
 static struct thread *
-next_thread_to_run (void) 
+next_thread_to_run (struct cpu *c) 
 {
-  if (list_empty (&ready_list))
-    return idle_thread;
-  else
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+  struct cpu *victim = NULL;
+  struct thread *t;
+  unsigned i;
+
+  t = runqueue_pop (&c->rq);
+  if (t != NULL)
+    return t;
+
+  for (i = 0; i < cpu_cnt; i++)
+    if (&cpus[i] != c && cpus[i].rq.ready_cnt > 0
+        && (victim == NULL || cpus[i].rq.ready_cnt > victim->rq.ready_cnt))
+      victim = &cpus[i];
+  if (victim != NULL)
+    {
+      t = runqueue_pop (&victim->rq);
+      if (t != NULL)
+        {
+          c->steal_cnt++;
+          return t;
+        }
+    }
+
+  return c->idle_thread;
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -659,7 +806,7 @@ thread_schedule_tail (struct thread *prev)
   cur->status = THREAD_RUNNING;
 
   /* Start new time slice. */
-  thread_ticks = 0;
+  cur->cpu->thread_ticks = 0;
 
 #ifdef USERPROG
   /* Activate the new address space. */
@@ -674,7 +821,7 @@ thread_schedule_tail (struct thread *prev)
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread) 
     {
       ASSERT (prev != cur);
-      palloc_free_page (prev);
+      thread_page_put (prev);
     }
 }
 
@@ -689,32 +836,110 @@ static void
 schedule (void) 
 {
   struct thread *cur = running_thread ();
-  struct thread *next = next_thread_to_run ();
+  struct thread *next = next_thread_to_run (cur->cpu);
   struct thread *prev = NULL;
 
   ASSERT (intr_get_level () == INTR_OFF);
   ASSERT (cur->status != THREAD_RUNNING);
   ASSERT (is_thread (next));
 
+  next->cpu = cur->cpu;
   if (cur != next) 
-    prev = switch_threads (cur, next);
+    {
+      /* CUR ran until now; NEXT waited until now, for a CPU or,
+         if it is an idle thread, for something to do. */
+      account_state_change (cur, &cur->run_tsc);
+      account_state_change (next, &next->ready_tsc);
+      if (cur->status == THREAD_READY && cur->preempted)
+        {
+          cur->invol_switches++;
+          invol_switch_cnt++;
+        }
+      else
+        {
+          cur->vol_switches++;
+          vol_switch_cnt++;
+        }
+      sched_trace_record (cur, next);
+      prev = switch_threads (cur, next);
+    }
 
   thread_schedule_tail (prev);
 }
 
-/* Returns a tid to use for a new thread. */
+/* Adds the time since T's last state change to *COUNTER and
+   records a state change now. */
+static void
+account_state_change (struct thread *t, uint64_t *counter) 
+{
+  uint64_t now = rdtsc ();
+
+  *counter += now - t->stamp_tsc;
+  t->stamp_tsc = now;
+}
+
+/* Returns a tid to use for a new thread.  Lock-free: a single
+   atomic fetch-and-add on next_tid. */
 static tid_t
 allocate_tid (void) 
 {
-  static tid_t next_tid = 1;
-  tid_t tid;
-
-  lock_acquire (&tid_lock);
-  tid = next_tid++;
-  lock_release (&tid_lock);
+  tid_t tid = 1;
 
+  asm volatile ("lock xaddl %0, %1"
+                : "+r" (tid), "+m" (next_tid) : : "memory");
   return tid;
 }
+
+/* Returns a page for a new thread, from the thread page cache if
+   possible, otherwise from the page allocator.  The page's
+   contents are not cleared.  Returns a null pointer if no page
+   is available. */
+static void *
+thread_page_get (void) 
+{
+  struct thread_page *page;
+
+  spinlock_acquire (&thread_page_cache_lock);
+  page = thread_page_cache;
+  if (page != NULL)
+    {
+      thread_page_cache = page->next;
+      thread_page_cache_cnt--;
+      thread_page_reuse_cnt++;
+    }
+  spinlock_release (&thread_page_cache_lock);
+
+  if (page == NULL)
+    {
+      page = palloc_get_page (0);
+      if (page != NULL)
+        thread_page_alloc_cnt++;
+    }
+  return page;
+}
+
+/* Releases PAGE, which belonged to a thread that has died, to
+   the thread page cache, or to the page allocator if the cache
+   is full. */
+static void
+thread_page_put (void *page_) 
+{
+  struct thread_page *page = page_;
+  bool cached = false;
+
+  spinlock_acquire (&thread_page_cache_lock);
+  if (thread_page_cache_cnt < THREAD_PAGE_CACHE_MAX)
+    {
+      page->next = thread_page_cache;
+      thread_page_cache = page;
+      thread_page_cache_cnt++;
+      cached = true;
+    }
+  spinlock_release (&thread_page_cache_lock);
+
+  if (!cached)
+    palloc_free_page (page);
+}
 
 /* Offset of `stack' member within `struct thread'.
    Used by switch.S, which can't figure it out on its own. */
@@ -2,11 +2,16 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <hash.h>
 #include <list.h>
 #include <stdint.h>
 #include "threads/fixed-point.h"
 #include "threads/synch.h"
 #include "filesys/directory.h"
+#ifdef USERPROG
+#include "userprog/fdtable.h"
+#endif
+
 /* States in a thread's life cycle. */
 enum thread_status
   {
@@ -90,10 +95,10 @@ struct thread
     char name[20];                      /* Name (for debugging purposes). */
     uint8_t *stack;                     /* Saved stack pointer. */
     int priority;                       /* Priority. */
-    int exit_status;
     int donated_priority;
     struct thread * donated_by;
     struct lock * waiting_for_lock;
+    struct mutex *waiting_for_mutex;
     struct semaphore * waiting_for_semaphore;
     struct list donate_list;
     struct list_elem allelem;           /* List element for all threads list. */
@@ -106,16 +111,41 @@ struct thread
     int nice;
     fixed_point recent_cpu;
 
-    struct semaphore one;
-    struct semaphore two;
-    struct semaphore load;
-    struct list file_descriptors;
-    struct list dir_descriptors;
     struct file *file;
     block_sector_t current_dir;
+    struct cpu *cpu;                    /* CPU running or last ran on. */
+
+    /* Scheduler statistics, in TSC cycles.  Owned by thread.c,
+       except that synch.c splits out time blocked on locks and
+       semaphores. */
+    uint64_t stamp_tsc;                 /* TSC at last state change. */
+    uint64_t run_tsc;                   /* Time spent running. */
+    uint64_t ready_tsc;                 /* Time spent waiting for a CPU. */
+    uint64_t block_tsc;                 /* Time spent blocked, for any reason. */
+    uint64_t lock_block_tsc;            /* ...of which on locks and mutexes. */
+    uint64_t sema_block_tsc;            /* ...of which on other semaphores. */
+    unsigned vol_switches;              /* # of times blocked, yielded or exited. */
+    unsigned invol_switches;            /* # of times preempted. */
+    bool preempted;                     /* Last yield was a preemption? */
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
+    struct fd_table fds;                /* Open files and directories. */
+    int exit_status;                    /* Status reported to our parent. */
+    struct child *child;                /* Our record in our parent, or null. */
+    struct list children;               /* Records of our children. */
+
+    /* Owned by userprog/syscall.c. */
+    struct ring *ring;                  /* Submission ring, or null. */
+#endif
+#ifdef VM
+    /* Owned by vm/page.c. */
+    struct hash pages;                  /* Supplemental page table. */
+    void *user_esp;                     /* User esp at system call entry. */
+
+    /* Owned by vm/mmap.c. */
+    struct list mappings;               /* Memory-mapped files. */
+    int next_mapid;                     /* Next mapping identifier. */
 #endif
 
     /* Owned by thread.c. */
@@ -133,6 +163,7 @@ struct list all_list;
 
 void thread_tick (void);
 void thread_print_stats (void);
+void thread_print_sched_stats (void);
 void thread_push_priority (struct list *, struct list_elem *);
 void print_list (struct list *);
 typedef void thread_func (void *aux);
@@ -147,6 +178,7 @@ const char *thread_name (void);
 
 void thread_exit (void) NO_RETURN;
 void thread_yield (void);
+void thread_preempt (void);
 
 /* Performs some operation on thread t, given auxiliary data AUX. */
 typedef void thread_action_func (struct thread *t, void *aux);
@@ -0,0 +1,233 @@
+#include "threads/workqueue.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Deferred work.
+
+   Instead of creating a kernel thread for every background job,
+   subsystems submit work items to a fixed pool of worker
+   threads.  Submitted items wait on one pending list per
+   priority class; delayed items wait on a list sorted by the
+   tick at which they become due, which the timer interrupt
+   checks through workqueue_tick().  Each pending item is
+   counted in work_sema, on which idle workers block.
+
+   Work items may be submitted from interrupt context.  The lists
+   are therefore protected by a spinlock, which disables
+   interrupts while held. */
+
+/* Number of worker threads. */
+#define WORKER_CNT 2
+
+static struct list pending_list[WORK_CLASS_CNT];
+static struct list delayed_list;        /* Ordered by wake_tick. */
+static struct spinlock work_lock;       /* Protects the lists above. */
+static struct semaphore work_sema;      /* Ups once per pending item. */
+
+/* Statistics. */
+static long long run_cnt[WORK_CLASS_CNT];  /* # of items run, by class. */
+static long long delayed_cnt;              /* # of delayed submissions. */
+
+static thread_func worker_thread;
+static void queue_pending (struct work *);
+static bool wake_tick_less (const struct list_elem *,
+                            const struct list_elem *, void *aux);
+
+/* Initializes W to run FUNC(W), with W->aux set to AUX, at the
+   given priority CLASS. */
+void
+work_init (struct work *w, work_func *func, void *aux, enum work_class class)
+{
+  ASSERT (w != NULL);
+  ASSERT (func != NULL);
+  ASSERT (class < WORK_CLASS_CNT);
+
+  w->func = func;
+  w->aux = aux;
+  w->class = class;
+  w->wake_tick = 0;
+  w->pending = false;
+}
+
+/* Queues W to be run by a worker thread as soon as one is free.
+   Returns false, doing nothing, if W is already pending.  May be
+   called from an interrupt handler. */
+bool
+work_submit (struct work *w)
+{
+  bool queued = false;
+
+  spinlock_acquire (&work_lock);
+  if (!w->pending)
+    {
+      w->pending = true;
+      queue_pending (w);
+      queued = true;
+    }
+  spinlock_release (&work_lock);
+
+  if (queued)
+    sema_up (&work_sema);
+  return queued;
+}
+
+/* Queues W to be run by a worker thread once at least TICKS
+   timer ticks have passed.  Returns false, doing nothing, if W
+   is already pending.  May be called from an interrupt
+   handler. */
+bool
+work_submit_delayed (struct work *w, int64_t ticks)
+{
+  bool queued = false;
+
+  if (ticks <= 0)
+    return work_submit (w);
+
+  spinlock_acquire (&work_lock);
+  if (!w->pending)
+    {
+      w->pending = true;
+      w->wake_tick = timer_ticks () + ticks;
+      list_insert_ordered (&delayed_list, &w->elem, wake_tick_less, NULL);
+      delayed_cnt++;
+      queued = true;
+    }
+  spinlock_release (&work_lock);
+  return queued;
+}
+
+/* Removes W from its queue if it has not started running yet.
+   Returns true if W was cancelled, false if it was not
+   pending. */
+bool
+work_cancel (struct work *w)
+{
+  bool cancelled = false;
+
+  spinlock_acquire (&work_lock);
+  if (w->pending)
+    {
+      list_remove (&w->elem);
+      w->pending = false;
+      cancelled = true;
+    }
+  spinlock_release (&work_lock);
+
+  /* A cancelled immediate item leaves an extra count in
+     work_sema; the worker that consumes it finds nothing to run
+     and goes back to sleep. */
+  return cancelled;
+}
+
+/* Initializes the work queues and starts the worker threads.
+   Must be called before the timer interrupt is enabled. */
+void
+workqueue_init (void)
+{
+  int i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (i = 0; i < WORK_CLASS_CNT; i++)
+    list_init (&pending_list[i]);
+  list_init (&delayed_list);
+  spinlock_init (&work_lock);
+  sema_init (&work_sema, 0);
+
+  for (i = 0; i < WORKER_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "worker%d", i);
+      if (thread_create (name, PRI_DEFAULT, worker_thread, NULL)
+          == TID_ERROR)
+        PANIC ("could not start worker thread");
+    }
+}
+
+/* Moves delayed work that is due at tick NOW to the pending
+   lists.  Called by the timer interrupt handler. */
+void
+workqueue_tick (int64_t now)
+{
+  int woken = 0;
+
+  ASSERT (intr_context ());
+
+  spinlock_acquire (&work_lock);
+  while (!list_empty (&delayed_list))
+    {
+      struct work *w = list_entry (list_front (&delayed_list),
+                                   struct work, elem);
+      if (w->wake_tick > now)
+        break;
+      list_pop_front (&delayed_list);
+      queue_pending (w);
+      woken++;
+    }
+  spinlock_release (&work_lock);
+
+  while (woken-- > 0)
+    sema_up (&work_sema);
+}
+
+/* Prints work queue statistics. */
+void
+workqueue_print_stats (void)
+{
+  printf ("Workqueue: %lld high, %lld normal, %lld low items run, "
+          "%lld delayed\n",
+          run_cnt[WORK_HIGH], run_cnt[WORK_NORMAL], run_cnt[WORK_LOW],
+          delayed_cnt);
+}
+
+/* Worker thread.  Runs pending work, highest class first,
+   forever. */
+static void
+worker_thread (void *aux UNUSED)
+{
+  for (;;)
+    {
+      struct work *w = NULL;
+      int i;
+
+      sema_down (&work_sema);
+
+      spinlock_acquire (&work_lock);
+      for (i = 0; i < WORK_CLASS_CNT; i++)
+        if (!list_empty (&pending_list[i]))
+          {
+            w = list_entry (list_pop_front (&pending_list[i]),
+                            struct work, elem);
+            w->pending = false;
+            run_cnt[i]++;
+            break;
+          }
+      spinlock_release (&work_lock);
+
+      if (w != NULL)
+        w->func (w);
+    }
+}
+
+/* Appends W to the pending list for its class.  The caller must
+   hold work_lock and up work_sema afterward. */
+static void
+queue_pending (struct work *w)
+{
+  list_push_back (&pending_list[w->class], &w->elem);
+}
+
+/* Returns true if work A is due before work B. */
+static bool
+wake_tick_less (const struct list_elem *a_, const struct list_elem *b_,
+                void *aux UNUSED)
+{
+  const struct work *a = list_entry (a_, struct work, elem);
+  const struct work *b = list_entry (b_, struct work, elem);
+
+  return a->wake_tick < b->wake_tick;
+}
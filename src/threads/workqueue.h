@@ -0,0 +1,47 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Priority classes of work.  Pending high-class work is always
+   run before normal, and normal before low. */
+enum work_class
+  {
+    WORK_HIGH,                  /* Latency-sensitive work. */
+    WORK_NORMAL,                /* Ordinary deferred work. */
+    WORK_LOW,                   /* Speculative work, e.g. read-ahead. */
+    WORK_CLASS_CNT
+  };
+
+struct work;
+typedef void work_func (struct work *);
+
+/* A deferred job.
+
+   The submitter owns the storage, usually by embedding a struct
+   work in a larger structure and recovering it in FUNC with
+   list_entry()-style pointer arithmetic, or by passing AUX.  A
+   work item may be resubmitted, including from its own FUNC,
+   once it has started running. */
+struct work
+  {
+    struct list_elem elem;      /* Pending or delayed list element. */
+    work_func *func;            /* Function to run. */
+    void *aux;                  /* Auxiliary data for FUNC. */
+    enum work_class class;      /* Priority class. */
+    int64_t wake_tick;          /* For delayed work, tick to queue at. */
+    bool pending;               /* Queued or delayed, not yet started? */
+  };
+
+void work_init (struct work *, work_func *, void *aux, enum work_class);
+bool work_submit (struct work *);
+bool work_submit_delayed (struct work *, int64_t ticks);
+bool work_cancel (struct work *);
+
+void workqueue_init (void);
+void workqueue_tick (int64_t now);
+void workqueue_print_stats (void);
+
+#endif /* threads/workqueue.h */
@@ -2,8 +2,13 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include "userprog/gdt.h"
+#include "userprog/syscall.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
@@ -136,6 +141,39 @@ page_fault (struct intr_frame *f)
      (#PF)". */
   asm ("movl %%cr2, %0" : "=r" (fault_addr));
 
+#ifdef VM
+  /* A not-present user page may just not have been loaded yet,
+     whether the user process or the kernel, on its behalf,
+     touched it, or it may be the next page of a growing stack.
+     In the kernel, f->esp is the kernel stack pointer, so use
+     the user stack pointer saved on entry to the system call. */
+  if ((f->error_code & PF_P) == 0 && is_user_vaddr (fault_addr))
+    {
+      void *esp = ((f->error_code & PF_U) != 0
+                   ? f->esp : thread_current ()->user_esp);
+
+      intr_enable ();
+      if (page_fault_in (fault_addr) || page_grow_stack (fault_addr, esp))
+        {
+          page_fault_cnt++;
+          return;
+        }
+    }
+
+  /* A write to a present, read-only user page may hit a page
+     shared copy-on-write.  The kernel runs with CR0.WP set, so
+     its writes on the process's behalf fault here too. */
+  else if ((f->error_code & PF_W) != 0 && is_user_vaddr (fault_addr))
+    {
+      intr_enable ();
+      if (page_copy_on_write (fault_addr))
+        {
+          page_fault_cnt++;
+          return;
+        }
+    }
+#endif
+
   if ((uint32_t) f->esp > (uint32_t) 0xc0000000 || ((uint32_t) f->esp) < 0x08048000)
     handle_sys_exit (f, -1);
 
@@ -0,0 +1,139 @@
+#include "userprog/execcache.h"
+#include <debug.h>
+#include <list.h>
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* Executable image cache.
+
+   Starting a program means reading and checking its ELF header
+   and every program header before a single page can be mapped.
+   Programs that are run over and over, such as the tools in a
+   shell pipeline, get the same answer every time, so we keep
+   the parsed result here, keyed by inode number.
+
+   Each entry holds its inode open, so the inode number cannot
+   be reused while it is cached, and remembers the inode's write
+   count when it was parsed.  Any later write to the file changes
+   the count, which makes the entry stale.  Entries are kept in
+   most-recently-used order and the least recently used one is
+   dropped when the cache is full. */
+
+/* Maximum number of cached executables. */
+#define EXEC_CACHE_SIZE 8
+
+/* A cached executable. */
+struct exec_entry
+  {
+    struct list_elem elem;      /* Element in `entries'. */
+    struct inode *inode;        /* Executable, held open. */
+    unsigned write_cnt;         /* Its write count when parsed. */
+    struct exec_image image;    /* Parsed headers. */
+  };
+
+/* Cached executables, most recently used first. */
+static struct list entries;
+static size_t entry_cnt;
+
+/* Protects `entries' and `entry_cnt'. */
+static struct lock cache_lock;
+
+static struct exec_entry *find (block_sector_t inumber);
+static void discard (struct exec_entry *);
+
+/* Initializes the executable image cache. */
+void
+exec_cache_init (void) 
+{
+  list_init (&entries);
+  entry_cnt = 0;
+  lock_init (&cache_lock);
+}
+
+/* Looks up the executable in INODE.  If its image is cached and
+   INODE has not been written since it was parsed, copies it into
+   *IMAGE and returns true.  Otherwise returns false. */
+bool
+exec_cache_lookup (struct inode *inode, struct exec_image *image) 
+{
+  struct exec_entry *e;
+  bool found = false;
+
+  lock_acquire (&cache_lock);
+  e = find (inode_get_inumber (inode));
+  if (e != NULL)
+    {
+      if (e->write_cnt == inode_write_cnt (e->inode))
+        {
+          list_remove (&e->elem);
+          list_push_front (&entries, &e->elem);
+          *image = e->image;
+          found = true;
+        }
+      else
+        discard (e);
+    }
+  lock_release (&cache_lock);
+  return found;
+}
+
+/* Caches IMAGE, just parsed from INODE. */
+void
+exec_cache_insert (struct inode *inode, const struct exec_image *image) 
+{
+  struct exec_entry *e;
+
+  lock_acquire (&cache_lock);
+  e = find (inode_get_inumber (inode));
+  if (e != NULL)
+    discard (e);
+  else if (entry_cnt >= EXEC_CACHE_SIZE)
+    discard (list_entry (list_back (&entries), struct exec_entry, elem));
+
+  e = malloc (sizeof *e);
+  if (e != NULL)
+    {
+      e->inode = inode_reopen (inode);
+      e->write_cnt = inode_write_cnt (inode);
+      e->image = *image;
+      list_push_front (&entries, &e->elem);
+      entry_cnt++;
+    }
+  lock_release (&cache_lock);
+}
+
+/* Returns the entry for inode INUMBER, or a null pointer if
+   there is none.  Entries for files that have been removed are
+   discarded along the way, so that they do not keep the files'
+   blocks allocated.  Must be called with cache_lock held. */
+static struct exec_entry *
+find (block_sector_t inumber) 
+{
+  struct list_elem *el, *next;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  for (el = list_begin (&entries); el != list_end (&entries); el = next)
+    {
+      struct exec_entry *e = list_entry (el, struct exec_entry, elem);
+
+      next = list_next (el);
+      if (inode_removed (e->inode))
+        discard (e);
+      else if (inode_get_inumber (e->inode) == inumber)
+        return e;
+    }
+  return NULL;
+}
+
+/* Removes E from the cache and frees it.  Must be called with
+   cache_lock held. */
+static void
+discard (struct exec_entry *e) 
+{
+  list_remove (&e->elem);
+  entry_cnt--;
+  inode_close (e->inode);
+  free (e);
+}
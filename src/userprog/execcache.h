@@ -0,0 +1,37 @@
+#ifndef USERPROG_EXECCACHE_H
+#define USERPROG_EXECCACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct inode;
+
+/* Maximum number of loadable segments in an executable. */
+#define EXEC_SEGMENT_MAX 16
+
+/* One loadable segment, already validated and rounded out to
+   whole pages. */
+struct exec_segment
+  {
+    uint32_t file_page;         /* File offset of first page. */
+    void *upage;                /* User address of first page. */
+    uint32_t read_bytes;        /* Bytes to read from the file. */
+    uint32_t zero_bytes;        /* Bytes to zero after those. */
+    bool writable;              /* Writable by the process? */
+  };
+
+/* What load() needs to know about an executable, parsed out of
+   its ELF headers. */
+struct exec_image
+  {
+    void (*entry) (void);       /* Entry point. */
+    size_t segment_cnt;         /* Number of segments. */
+    struct exec_segment segments[EXEC_SEGMENT_MAX];
+  };
+
+void exec_cache_init (void);
+bool exec_cache_lookup (struct inode *, struct exec_image *);
+void exec_cache_insert (struct inode *, const struct exec_image *);
+
+#endif /* userprog/execcache.h */
@@ -0,0 +1,312 @@
+#include "userprog/fdtable.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "userprog/pipe.h"
+
+/* Descriptor tables.
+
+   A table is an array of slots indexed by descriptor number, so
+   looking up a descriptor is a bounds check and an array access.
+   A bitmap of the slots in use gives the lowest free descriptor
+   on open.  The table starts out empty and doubles whenever it
+   fills, up to FD_MAX slots. */
+
+/* Number of slots in a table's first allocation. */
+#define FD_MIN 16
+
+/* Maximum number of slots in a table. */
+#define FD_MAX 4096
+
+/* First descriptor that may be allocated. */
+#define FD_FIRST 2
+
+static int allocate (struct fd_table *, enum fd_type, void *);
+static struct fd_entry *lookup (struct fd_table *, int fd);
+static bool grow (struct fd_table *);
+static bool duplicate (struct fd_entry *dst, const struct fd_entry *src);
+
+/* Initializes T as an empty table. */
+void
+fd_table_init (struct fd_table *t) 
+{
+  t->entries = NULL;
+  t->used = NULL;
+  t->size = 0;
+}
+
+/* Closes every descriptor in T and frees T's memory. */
+void
+fd_table_destroy (struct fd_table *t) 
+{
+  size_t fd;
+
+  for (fd = 0; fd < t->size; fd++)
+    fd_close (t, fd);
+  free (t->entries);
+  bitmap_destroy (t->used);
+  fd_table_init (t);
+}
+
+/* Makes DST, which must be empty, a copy of SRC in which each
+   file, directory, or pipe end is reopened under the same
+   descriptor.  Files are reopened at the same position but do
+   not share it.  Returns false if memory is exhausted. */
+bool
+fd_table_copy (struct fd_table *dst, struct fd_table *src) 
+{
+  size_t fd;
+
+  ASSERT (dst->size == 0);
+
+  if (src->size == 0)
+    return true;
+  dst->entries = calloc (src->size, sizeof *dst->entries);
+  dst->used = bitmap_create (src->size);
+  if (dst->entries == NULL || dst->used == NULL)
+    {
+      fd_table_destroy (dst);
+      return false;
+    }
+  dst->size = src->size;
+  bitmap_set_multiple (dst->used, 0, FD_FIRST, true);
+
+  for (fd = 0; fd < src->size; fd++)
+    {
+      struct fd_entry *s = &src->entries[fd];
+
+      if (s->type == FD_NONE)
+        continue;
+      if (!duplicate (&dst->entries[fd], s))
+        return false;
+      bitmap_mark (dst->used, fd);
+    }
+  return true;
+}
+
+/* Adds FILE to T under the lowest free descriptor and returns
+   it, or returns -1 if T is full. */
+int
+fd_open_file (struct fd_table *t, struct file *file) 
+{
+  return allocate (t, FD_FILE, file);
+}
+
+/* Adds DIR to T under the lowest free descriptor and returns it,
+   or returns -1 if T is full. */
+int
+fd_open_dir (struct fd_table *t, struct dir *dir) 
+{
+  return allocate (t, FD_DIR, dir);
+}
+
+/* Adds the write end of PIPE, if WRITE is true, or its read end,
+   to T under the lowest free descriptor and returns it, or
+   returns -1 if T is full. */
+int
+fd_open_pipe (struct fd_table *t, struct pipe *pipe, bool write) 
+{
+  return allocate (t, write ? FD_PIPE_WRITE : FD_PIPE_READ, pipe);
+}
+
+/* Makes NEW_FD in T refer to what OLD_FD does, closing whatever
+   NEW_FD referred to first.  NEW_FD may be 0 or 1, to redirect
+   the console.  A file is reopened at the same position, as in
+   fd_table_copy(), rather than sharing it.  Returns NEW_FD, or
+   -1 if OLD_FD is not open, NEW_FD is out of range, or memory
+   is exhausted. */
+int
+fd_dup2 (struct fd_table *t, int old_fd, int new_fd) 
+{
+  struct fd_entry *old = lookup (t, old_fd);
+  struct fd_entry copy;
+
+  if (old == NULL || old->type == FD_NONE || new_fd < 0 || new_fd >= FD_MAX)
+    return -1;
+  if (new_fd == old_fd)
+    return new_fd;
+  while ((size_t) new_fd >= t->size)
+    if (!grow (t))
+      return -1;
+
+  /* Growing T may have moved OLD. */
+  old = lookup (t, old_fd);
+  if (!duplicate (&copy, old))
+    return -1;
+  fd_close (t, new_fd);
+  t->entries[new_fd] = copy;
+  bitmap_mark (t->used, new_fd);
+  return new_fd;
+}
+
+/* Returns true if FD in T refers to anything, false if it is
+   free or, for descriptors 0 and 1, still the console. */
+bool
+fd_is_open (struct fd_table *t, int fd) 
+{
+  struct fd_entry *e = lookup (t, fd);
+  return e != NULL && e->type != FD_NONE;
+}
+
+/* Returns the file open as FD in T, or a null pointer if FD is
+   not an open file. */
+struct file *
+fd_get_file (struct fd_table *t, int fd) 
+{
+  struct fd_entry *e = lookup (t, fd);
+  return e != NULL && e->type == FD_FILE ? e->u.file : NULL;
+}
+
+/* Returns the directory open as FD in T, or a null pointer if FD
+   is not an open directory. */
+struct dir *
+fd_get_dir (struct fd_table *t, int fd) 
+{
+  struct fd_entry *e = lookup (t, fd);
+  return e != NULL && e->type == FD_DIR ? e->u.dir : NULL;
+}
+
+/* Returns the pipe whose write end, if WRITE is true, or read
+   end is open as FD in T, or a null pointer if FD is not that
+   end of a pipe. */
+struct pipe *
+fd_get_pipe (struct fd_table *t, int fd, bool write) 
+{
+  struct fd_entry *e = lookup (t, fd);
+  return (e != NULL && e->type == (write ? FD_PIPE_WRITE : FD_PIPE_READ)
+          ? e->u.pipe : NULL);
+}
+
+/* Closes FD in T and frees its descriptor.  Returns false if FD
+   is not open. */
+bool
+fd_close (struct fd_table *t, int fd) 
+{
+  struct fd_entry *e = lookup (t, fd);
+
+  if (e == NULL || e->type == FD_NONE)
+    return false;
+  if (e->type == FD_FILE)
+    file_close (e->u.file);
+  else if (e->type == FD_DIR)
+    dir_close (e->u.dir);
+  else
+    pipe_close (e->u.pipe, e->type == FD_PIPE_WRITE);
+  e->type = FD_NONE;
+  if (fd >= FD_FIRST)
+    bitmap_reset (t->used, fd);
+  return true;
+}
+
+/* Stores OBJ, of the given TYPE, in the lowest free slot of T,
+   growing T if necessary, and returns the slot's descriptor.
+   Returns -1 if T cannot grow. */
+static int
+allocate (struct fd_table *t, enum fd_type type, void *obj) 
+{
+  size_t fd;
+  struct fd_entry *e;
+
+  fd = t->used != NULL ? bitmap_scan_and_flip (t->used, FD_FIRST, 1, false)
+                       : BITMAP_ERROR;
+  if (fd == BITMAP_ERROR)
+    {
+      fd = t->size > FD_FIRST ? t->size : FD_FIRST;
+      if (!grow (t))
+        return -1;
+      bitmap_mark (t->used, fd);
+    }
+
+  e = &t->entries[fd];
+  e->type = type;
+  if (type == FD_FILE)
+    e->u.file = obj;
+  else if (type == FD_DIR)
+    e->u.dir = obj;
+  else
+    e->u.pipe = obj;
+  return fd;
+}
+
+/* Returns FD's slot in T, or a null pointer if FD is out of
+   range. */
+static struct fd_entry *
+lookup (struct fd_table *t, int fd) 
+{
+  if (fd < 0 || (size_t) fd >= t->size)
+    return NULL;
+  return &t->entries[fd];
+}
+
+/* Doubles the number of slots in T, or gives it FD_MIN slots if
+   it has none.  Returns false if T is already at FD_MAX slots or
+   memory is exhausted. */
+static bool
+grow (struct fd_table *t) 
+{
+  size_t new_size = t->size == 0 ? FD_MIN : t->size * 2;
+  struct fd_entry *entries;
+  struct bitmap *used;
+  size_t fd;
+
+  if (new_size > FD_MAX)
+    return false;
+  used = bitmap_create (new_size);
+  if (used == NULL)
+    return false;
+  entries = realloc (t->entries, new_size * sizeof *entries);
+  if (entries == NULL)
+    {
+      bitmap_destroy (used);
+      return false;
+    }
+  memset (entries + t->size, 0, (new_size - t->size) * sizeof *entries);
+
+  bitmap_set_multiple (used, 0, FD_FIRST, true);
+  for (fd = FD_FIRST; fd < t->size; fd++)
+    if (entries[fd].type != FD_NONE)
+      bitmap_mark (used, fd);
+  bitmap_destroy (t->used);
+
+  t->entries = entries;
+  t->used = used;
+  t->size = new_size;
+  return true;
+}
+
+/* Makes DST, which must be unused, refer to what SRC does,
+   reopening SRC's file, directory, or pipe end.  Returns false
+   if memory is exhausted. */
+static bool
+duplicate (struct fd_entry *dst, const struct fd_entry *src) 
+{
+  switch (src->type)
+    {
+    case FD_FILE:
+      dst->u.file = file_reopen (src->u.file);
+      if (dst->u.file == NULL)
+        return false;
+      file_seek (dst->u.file, file_tell (src->u.file));
+      break;
+
+    case FD_DIR:
+      dst->u.dir = dir_reopen (src->u.dir);
+      if (dst->u.dir == NULL)
+        return false;
+      break;
+
+    case FD_PIPE_READ:
+    case FD_PIPE_WRITE:
+      dst->u.pipe = src->u.pipe;
+      pipe_reopen (src->u.pipe, src->type == FD_PIPE_WRITE);
+      break;
+
+    default:
+      NOT_REACHED ();
+    }
+  dst->type = src->type;
+  return true;
+}
@@ -0,0 +1,60 @@
+#ifndef USERPROG_FDTABLE_H
+#define USERPROG_FDTABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct bitmap;
+struct dir;
+struct file;
+struct pipe;
+
+/* What a descriptor refers to. */
+enum fd_type
+  {
+    FD_NONE,                    /* Free slot. */
+    FD_FILE,                    /* Open file. */
+    FD_DIR,                     /* Open directory. */
+    FD_PIPE_READ,               /* Read end of a pipe. */
+    FD_PIPE_WRITE               /* Write end of a pipe. */
+  };
+
+/* One slot of a descriptor table. */
+struct fd_entry
+  {
+    enum fd_type type;          /* What the descriptor refers to. */
+    union
+      {
+        struct file *file;      /* For FD_FILE. */
+        struct dir *dir;        /* For FD_DIR. */
+        struct pipe *pipe;      /* For FD_PIPE_READ and FD_PIPE_WRITE. */
+      }
+    u;
+  };
+
+/* A process's file, directory, and pipe descriptors, indexed by
+   descriptor number.  Descriptors 0 and 1 are the console and
+   are never allocated, but fd_dup2() can put something else in
+   their slots, and closing it there restores the console. */
+struct fd_table
+  {
+    struct fd_entry *entries;   /* Slots, indexed by descriptor. */
+    struct bitmap *used;        /* Slots in use. */
+    size_t size;                /* Number of slots. */
+  };
+
+void fd_table_init (struct fd_table *);
+void fd_table_destroy (struct fd_table *);
+bool fd_table_copy (struct fd_table *dst, struct fd_table *src);
+
+int fd_open_file (struct fd_table *, struct file *);
+int fd_open_dir (struct fd_table *, struct dir *);
+int fd_open_pipe (struct fd_table *, struct pipe *, bool write);
+int fd_dup2 (struct fd_table *, int old_fd, int new_fd);
+bool fd_is_open (struct fd_table *, int fd);
+struct file *fd_get_file (struct fd_table *, int fd);
+struct dir *fd_get_dir (struct fd_table *, int fd);
+struct pipe *fd_get_pipe (struct fd_table *, int fd, bool write);
+bool fd_close (struct fd_table *, int fd);
+
+#endif /* userprog/fdtable.h */
@@ -214,6 +214,32 @@ pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed)
     }
 }
 
+/* Returns true if the PTE for virtual page VPAGE in PD is present
+   and writable.  Returns false if PD contains no PTE for VPAGE or
+   the page is read-only. */
+bool
+pagedir_is_writable (uint32_t *pd, const void *vpage)
+{
+  uint32_t *pte = lookup_page (pd, vpage, false);
+  return pte != NULL && (*pte & PTE_P) != 0 && (*pte & PTE_W) != 0;
+}
+
+/* Sets the writable bit to WRITABLE in the PTE for virtual page
+   VPAGE in PD, leaving its accessed and dirty bits alone. */
+void
+pagedir_set_writable (uint32_t *pd, const void *vpage, bool writable) 
+{
+  uint32_t *pte = lookup_page (pd, vpage, false);
+  if (pte != NULL) 
+    {
+      if (writable)
+        *pte |= PTE_W;
+      else
+        *pte &= ~(uint32_t) PTE_W;
+      invalidate_pagedir (pd);
+    }
+}
+
 /* Loads page directory PD into the CPU's page directory base
    register. */
 void
@@ -0,0 +1,167 @@
+#include "userprog/pipe.h"
+#include <debug.h>
+#include <stdint.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Pipes.
+
+   A pipe is a one-page ring buffer with a read end and a write
+   end, each of which may be open in any number of descriptors,
+   in any number of processes.  Readers block while the buffer is
+   empty and writers while it is full, so a producer and a
+   consumer run in lock step without the data ever leaving
+   memory.  Once every writer has closed, readers drain what is
+   left and then see end of file; once every reader has closed,
+   writes stop short.  The pipe is freed when both ends are
+   closed. */
+
+/* Size of a pipe's buffer, in bytes. */
+#define PIPE_SIZE PGSIZE
+
+struct pipe
+  {
+    struct lock lock;           /* Protects all the members below. */
+    struct condition not_empty; /* Data arrived, or last writer closed. */
+    struct condition not_full;  /* Space freed, or last reader closed. */
+    uint8_t *buffer;            /* PIPE_SIZE bytes of data. */
+    size_t head;                /* Total bytes ever read. */
+    size_t tail;                /* Total bytes ever written. */
+    unsigned reader_cnt;        /* Open read ends. */
+    unsigned writer_cnt;        /* Open write ends. */
+  };
+
+/* Creates a new, empty pipe with one read end and one write end
+   open.  Returns the pipe, or a null pointer if memory is
+   exhausted. */
+struct pipe *
+pipe_create (void) 
+{
+  struct pipe *p = malloc (sizeof *p);
+  if (p == NULL)
+    return NULL;
+  p->buffer = palloc_get_page (0);
+  if (p->buffer == NULL)
+    {
+      free (p);
+      return NULL;
+    }
+  lock_init (&p->lock);
+  cond_init (&p->not_empty);
+  cond_init (&p->not_full);
+  p->head = p->tail = 0;
+  p->reader_cnt = p->writer_cnt = 1;
+  return p;
+}
+
+/* Opens another write end of P if WRITE is true, otherwise
+   another read end. */
+void
+pipe_reopen (struct pipe *p, bool write) 
+{
+  lock_acquire (&p->lock);
+  if (write)
+    p->writer_cnt++;
+  else
+    p->reader_cnt++;
+  lock_release (&p->lock);
+}
+
+/* Closes a write end of P if WRITE is true, otherwise a read
+   end, and frees P if that was the last end open. */
+void
+pipe_close (struct pipe *p, bool write) 
+{
+  bool last;
+
+  lock_acquire (&p->lock);
+  if (write)
+    {
+      ASSERT (p->writer_cnt > 0);
+      if (--p->writer_cnt == 0)
+        cond_broadcast (&p->not_empty, &p->lock);
+    }
+  else
+    {
+      ASSERT (p->reader_cnt > 0);
+      if (--p->reader_cnt == 0)
+        cond_broadcast (&p->not_full, &p->lock);
+    }
+  last = p->reader_cnt == 0 && p->writer_cnt == 0;
+  lock_release (&p->lock);
+
+  if (last)
+    {
+      palloc_free_page (p->buffer);
+      free (p);
+    }
+}
+
+/* Reads up to SIZE bytes from P into BUFFER.  If P is empty and
+   BLOCK is true, first waits until some data arrives or every
+   write end is closed.  Returns the number of bytes read, which
+   is 0 at end of file or if P is empty and BLOCK is false. */
+size_t
+pipe_read (struct pipe *p, void *buffer_, size_t size, bool block) 
+{
+  uint8_t *buffer = buffer_;
+  size_t bytes = 0;
+
+  lock_acquire (&p->lock);
+  while (block && size > 0 && p->head == p->tail && p->writer_cnt > 0)
+    cond_wait (&p->not_empty, &p->lock);
+
+  while (bytes < size && p->head != p->tail)
+    {
+      size_t ofs = p->head % PIPE_SIZE;
+      size_t chunk = p->tail - p->head;
+
+      if (chunk > PIPE_SIZE - ofs)
+        chunk = PIPE_SIZE - ofs;
+      if (chunk > size - bytes)
+        chunk = size - bytes;
+      memcpy (buffer + bytes, p->buffer + ofs, chunk);
+      p->head += chunk;
+      bytes += chunk;
+    }
+  if (bytes > 0)
+    cond_broadcast (&p->not_full, &p->lock);
+  lock_release (&p->lock);
+  return bytes;
+}
+
+/* Writes SIZE bytes from BUFFER to P, waiting for space as
+   necessary.  Returns the number of bytes written, which is less
+   than SIZE only if every read end is closed. */
+size_t
+pipe_write (struct pipe *p, const void *buffer_, size_t size) 
+{
+  const uint8_t *buffer = buffer_;
+  size_t bytes = 0;
+
+  lock_acquire (&p->lock);
+  while (bytes < size && p->reader_cnt > 0)
+    {
+      size_t ofs = p->tail % PIPE_SIZE;
+      size_t chunk = PIPE_SIZE - (p->tail - p->head);
+
+      if (chunk == 0)
+        {
+          cond_wait (&p->not_full, &p->lock);
+          continue;
+        }
+      if (chunk > PIPE_SIZE - ofs)
+        chunk = PIPE_SIZE - ofs;
+      if (chunk > size - bytes)
+        chunk = size - bytes;
+      memcpy (p->buffer + ofs, buffer + bytes, chunk);
+      p->tail += chunk;
+      bytes += chunk;
+      cond_broadcast (&p->not_empty, &p->lock);
+    }
+  lock_release (&p->lock);
+  return bytes;
+}
@@ -0,0 +1,15 @@
+#ifndef USERPROG_PIPE_H
+#define USERPROG_PIPE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct pipe;
+
+struct pipe *pipe_create (void);
+void pipe_reopen (struct pipe *, bool write);
+void pipe_close (struct pipe *, bool write);
+size_t pipe_read (struct pipe *, void *, size_t size, bool block);
+size_t pipe_write (struct pipe *, const void *, size_t size);
+
+#endif /* userprog/pipe.h */
@@ -5,9 +5,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "userprog/execcache.h"
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
 #include "userprog/tss.h"
+#include "userprog/uaccess.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
@@ -19,53 +21,102 @@
 #include "threads/vaddr.h"
 #include "threads/malloc.h"
 #include "threads/synch.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
  
+/* A parent's record of one of its children.  The parent keeps
+   it on its `children' list and the child points to it, so exec
+   and wait never search the thread list.  It is shared by the
+   two and freed by whichever of them drops the last reference,
+   so a child that exits before its parent waits leaves only
+   this record behind, and a parent that exits first simply lets
+   go of it. */
+struct child
+  {
+    tid_t tid;                  /* Child's thread id. */
+    int exit_status;            /* Valid once EXITED is upped. */
+    bool loaded;                /* Valid once LOADED is upped. */
+    struct semaphore load;      /* Upped when the child has loaded. */
+    struct semaphore exited;    /* Upped when the child has exited. */
+    struct spinlock lock;       /* Protects REF_CNT. */
+    int ref_cnt;                /* 2 while both are alive, then 1. */
+    struct list_elem elem;      /* Element in parent's `children'. */
+  };
+
+/* Arguments passed from process_execute() to start_process(). */
+struct exec_args
+  {
+    const char *cmd_line;       /* Program name and arguments. */
+    struct child *child;        /* Record shared with the parent. */
+    struct fd_table *fds;       /* Parent's descriptors, inherited. */
+  };
+
 static thread_func start_process NO_RETURN;
-static bool load (const char *cmdline, void (**eip) (void), void **esp);
-/* Starts a new thread running a user program loaded from
-   FILENAME.  The new thread may be scheduled (and may even exit)
-   before process_execute() returns.  Returns the new process's
-   thread id, or TID_ERROR if the thread cannot be created. */
+#ifdef VM
+static thread_func fork_process NO_RETURN;
+#endif
+static bool load (const char *cmd_line, void (**eip) (void), void **esp);
+static struct child *child_create (void);
+static tid_t child_start (struct child *, tid_t);
+static void child_release (struct child *);
+
+/* Starts a new thread running the user program named by the
+   first word of CMD_LINE, passing it the remaining words as
+   arguments, and waits for it to finish loading.  CMD_LINE is
+   not copied: the new thread reads it straight onto its stack
+   before we return.  The new process inherits a copy of the
+   caller's file descriptors, including pipe ends and any
+   redirection of descriptors 0 and 1 made with dup2(), so a
+   parent can connect the children it runs with a pipe.
+   Returns the new process's thread id, or
+   TID_ERROR if the thread cannot be created or the program
+   cannot be loaded. */
 tid_t
-process_execute (const char *file_name) 
+process_execute (const char *cmd_line) 
 {
-  char *fn_copy;
+  struct exec_args args;
   tid_t tid;
 
-  /* Make a copy of FILE_NAME.
-     Otherwise there's a race between the caller and load(). */
-  fn_copy = palloc_get_page (0);
-  if (fn_copy == NULL)
+  args.cmd_line = cmd_line;
+  args.child = child_create ();
+  if (args.child == NULL)
     return TID_ERROR;
-  strlcpy (fn_copy, file_name, PGSIZE);
+  args.fds = &thread_current ()->fds;
 
-  sema_init (&load_sema, 0);
-  /* Create a new thread to execute FILE_NAME. */
-  tid = thread_create (file_name, PRI_DEFAULT, start_process, fn_copy);
-  if (tid == TID_ERROR)
-    palloc_free_page (fn_copy); 
-  return tid;
+  /* Create a new thread to execute CMD_LINE. */
+  tid = thread_create (cmd_line, PRI_DEFAULT, start_process, &args);
+  return child_start (args.child, tid);
 }
 
 /* A thread function that loads a user process and starts it
    running. */
 static void
-start_process (void *file_name_)
+start_process (void *args_)
 {
-  char *file_name = file_name_;
+  struct exec_args *args = args_;
+  struct thread *cur = thread_current ();
   struct intr_frame if_;
+  bool success;
+
+  /* ARGS, the command line, and the descriptors we copy belong
+     to the parent, which waits for us to load. */
+  cur->child = args->child;
 
   /* Initialize interrupt frame and load executable. */
   memset (&if_, 0, sizeof if_);
   if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
   if_.cs = SEL_UCSEG;
   if_.eflags = FLAG_IF | FLAG_MBS;
-  load_success = load (file_name, &if_.eip, &if_.esp);
+  success = (load (args->cmd_line, &if_.eip, &if_.esp)
+             && fd_table_copy (&cur->fds, args->fds));
+
+  cur->child->loaded = success;
+  sema_up (&cur->child->load);
 
-  sema_up (&thread_current ()->load);
   /* If load failed, quit. */
-  palloc_free_page (file_name);
-  if (!load_success) 
+  if (!success) 
     thread_exit ();
 
   /* Start the user process by simulating a return from an
@@ -78,34 +129,108 @@ start_process (void *file_name_)
   NOT_REACHED ();
 }
 
+#ifdef VM
+/* Arguments passed from process_fork() to fork_process(). */
+struct fork_args
+  {
+    struct thread *parent;      /* Process being forked. */
+    struct intr_frame if_;      /* Its user registers at fork(). */
+    struct child *child;        /* Record shared with the parent. */
+  };
+
+/* Starts a new process that is a copy of the current one, which
+   entered the kernel through interrupt frame F.  The child shares
+   the parent's resident pages copy-on-write, so nothing is read
+   from the executable and nothing is copied until one of them
+   writes to a page.  The child resumes from F with a return
+   value of 0.  Returns the child's thread id, or TID_ERROR if
+   it cannot be created. */
+tid_t
+process_fork (const struct intr_frame *f) 
+{
+  struct fork_args args;
+  tid_t tid;
+
+  args.parent = thread_current ();
+  args.if_ = *f;
+  args.child = child_create ();
+  if (args.child == NULL)
+    return TID_ERROR;
+
+  tid = thread_create (args.parent->name, PRI_DEFAULT, fork_process, &args);
+  return child_start (args.child, tid);
+}
+
+/* A thread function that copies the address space and open
+   files of the process blocked in process_fork() and starts
+   running it. */
+static void
+fork_process (void *args_) 
+{
+  struct fork_args *args = args_;
+  struct thread *parent = args->parent;
+  struct thread *cur = thread_current ();
+  struct intr_frame if_ = args->if_;
+  bool success = false;
+
+  cur->child = args->child;
+  cur->pagedir = pagedir_create ();
+  if (cur->pagedir != NULL)
+    {
+      page_table_init (&cur->pages);
+      mmap_table_init ();
+      process_activate ();
+
+      cur->file = file_reopen (parent->file);
+      if (cur->file != NULL)
+        {
+          file_deny_write (cur->file);
+          success = (page_table_copy (&parent->pages, cur->file)
+                     && fd_table_copy (&cur->fds, &parent->fds));
+          cur->ring = parent->ring;
+        }
+    }
+
+  /* ARGS is on the parent's stack, so it is gone once the
+     parent wakes up. */
+  cur->child->loaded = success;
+  sema_up (&cur->child->load);
+  if (!success)
+    thread_exit ();
+
+  if_.eax = 0;
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+#endif
+
 /* Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
    exception), returns -1.  If TID is invalid or if it was not a
    child of the calling process, or if process_wait() has already
    been successfully called for the given TID, returns -1
-   immediately, without waiting.
-
-   This function will be implemented in problem 2-2.  For now, it
-   does nothing. */
+   immediately, without waiting. */
 int
 process_wait (tid_t child_tid) 
 {
-  int status;
+  struct list *children = &thread_current ()->children;
   struct list_elem *e;
-  for (e = list_begin (&all_list); e != list_end (&all_list);
+
+  for (e = list_begin (children); e != list_end (children);
        e = list_next (e))
     {
-      struct thread *t = list_entry (e, struct thread, allelem);
-      if (t->tid == child_tid)
-      	{
-	  sema_down (&t->one);
-	  status = t->exit_status;
-	  sema_up (&t->two);
-	  sema_down (&t->one);
-	  return status;
-      	}
-    } 
+      struct child *c = list_entry (e, struct child, elem);
+      if (c->tid == child_tid)
+        {
+          int status;
 
+          list_remove (&c->elem);
+          sema_down (&c->exited);
+          status = c->exit_status;
+          child_release (c);
+          return status;
+        }
+    }
   return -1;
 }
 
@@ -117,9 +242,13 @@ process_exit (void)
   uint32_t *pd;
 
 #ifdef USERPROG
-  sema_up (&cur->one);
-  sema_down (&cur->two);
-  file_close (cur->file);
+  fd_table_destroy (&cur->fds);
+
+  /* Children we never waited for no longer need their records
+     kept for us. */
+  while (!list_empty (&cur->children))
+    child_release (list_entry (list_pop_front (&cur->children),
+                               struct child, elem));
 #endif
   
   /* Destroy the current process's page directory and switch back
@@ -134,10 +263,95 @@ process_exit (void)
          directory before destroying the process's page
          directory, or our active page directory will be one
          that's been freed (and cleared). */
+#ifdef VM
+      /* Frames go back through the frame table and mapped files
+         are written back through PD, so tear down the mappings
+         and the supplemental page table while PD is still
+         valid. */
+      mmap_unmap_all ();
+      page_table_destroy (&cur->pages);
+#endif
       cur->pagedir = NULL;
       pagedir_activate (NULL);
       pagedir_destroy (pd);
     }
+
+#ifdef USERPROG
+  /* Close the executable only now.  Shared text frames are keyed
+     by its inode, which must stay open and denied writes until
+     the page table teardown above has dropped every frame that
+     refers to it; otherwise a new inode allocated at the same
+     address could match the stale frames. */
+  file_close (cur->file);
+  cur->file = NULL;
+#endif
+
+  /* Everything is released, so let our parent reap us. */
+  if (cur->child != NULL)
+    {
+      cur->child->exit_status = cur->exit_status;
+      sema_up (&cur->child->exited);
+      child_release (cur->child);
+      cur->child = NULL;
+    }
+}
+
+/* Returns a new child record with a reference for the parent and
+   one for the child, or a null pointer if memory is exhausted. */
+static struct child *
+child_create (void) 
+{
+  struct child *c = malloc (sizeof *c);
+  if (c != NULL)
+    {
+      c->tid = TID_ERROR;
+      c->exit_status = -1;
+      c->loaded = false;
+      sema_init (&c->load, 0);
+      sema_init (&c->exited, 0);
+      spinlock_init (&c->lock);
+      c->ref_cnt = 2;
+    }
+  return c;
+}
+
+/* Finishes starting child C, whose thread thread_create()
+   returned TID, by waiting for it to load its program.  Returns
+   TID and adds C to the current thread's children if the child
+   is running, otherwise drops the parent's reference (and the
+   child's as well, if there is no thread) and returns
+   TID_ERROR. */
+static tid_t
+child_start (struct child *c, tid_t tid) 
+{
+  if (tid == TID_ERROR)
+    {
+      free (c);
+      return TID_ERROR;
+    }
+
+  sema_down (&c->load);
+  if (!c->loaded)
+    {
+      child_release (c);
+      return TID_ERROR;
+    }
+  c->tid = tid;
+  list_push_back (&thread_current ()->children, &c->elem);
+  return tid;
+}
+
+/* Drops a reference to C, freeing it if it was the last. */
+static void
+child_release (struct child *c) 
+{
+  bool last;
+
+  spinlock_acquire (&c->lock);
+  last = --c->ref_cnt == 0;
+  spinlock_release (&c->lock);
+  if (last)
+    free (c);
 }
 
 /* Sets up the CPU for running user code in the current
@@ -220,45 +434,111 @@ struct Elf32_Phdr
 #define PF_R 4          /* Readable. */
 
 static bool setup_stack (void **esp);
+static bool setup_args (const char *cmd_line, void **esp, char **program);
+static bool read_image (struct file *, struct exec_image *);
 static bool validate_segment (const struct Elf32_Phdr *, struct file *);
 static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
                           uint32_t read_bytes, uint32_t zero_bytes,
                           bool writable);
 
-/* Loads an ELF executable from FILE_NAME into the current thread.
-   Stores the executable's entry point into *EIP
+/* Loads the ELF executable named by the first word of CMD_LINE
+   into the current thread, with the words of CMD_LINE as its
+   arguments.  Stores the executable's entry point into *EIP
    and its initial stack pointer into *ESP.
    Returns true if successful, false otherwise. */
 bool
-load (const char *file_name, void (**eip) (void), void **esp) 
+load (const char *cmd_line, void (**eip) (void), void **esp) 
 {
   struct thread *t = thread_current ();
-  struct Elf32_Ehdr ehdr;
+  uint8_t *stack_page = ((uint8_t *) PHYS_BASE) - PGSIZE;
+  struct exec_image image;
+  const struct exec_segment *seg;
   struct file *file = NULL;
-  off_t file_ofs;
+  char *program = NULL;
+  bool pinned = false;
   bool success = false;
-  int i;
-  char * f_name, * brkt;
 
-  f_name = strtok_r (file_name, " ", &brkt);
   /* Allocate and activate page directory. */
   t->pagedir = pagedir_create ();
   if (t->pagedir == NULL) 
     goto done;
+#ifdef VM
+  page_table_init (&t->pages);
+  mmap_table_init ();
+#endif
   process_activate ();
 
+  /* Set up stack and lay out the arguments on it.  The stack
+     page stays pinned for as long as we use the program name
+     there. */
+  if (!setup_stack (esp) || !user_pin (stack_page, PGSIZE, true))
+    goto done;
+  pinned = true;
+  if (!setup_args (cmd_line, esp, &program))
+    goto done;
+
   /* Open executable file. */
   dir_open_root ();
-  file = filesys_open (f_name);
+  file = filesys_open (program);
   if (file == NULL) 
     {
-      printf ("load: %s: open failed\n", f_name);
+      printf ("load: %s: open failed\n", program);
       goto done; 
     }
   thread_current ()->file = file;
   file_deny_write (file);
 
+  /* Read and verify the executable's headers, unless they are
+     cached from an earlier run and the file has not been written
+     since. */
+  if (!exec_cache_lookup (file_get_inode (file), &image))
+    {
+      if (!read_image (file, &image))
+        {
+          printf ("load: %s: error loading executable\n", program);
+          goto done; 
+        }
+      exec_cache_insert (file_get_inode (file), &image);
+    }
+
+  /* Load the segments. */
+  for (seg = image.segments; seg < image.segments + image.segment_cnt; seg++)
+    if (!load_segment (file, seg->file_page, seg->upage,
+                       seg->read_bytes, seg->zero_bytes, seg->writable))
+      goto done;
+
+  /* Start address. */
+  *eip = image.entry;
+
+  success = true;
+
+ done:
+  /* We arrive here whether the load is successful or not. */
+  if (pinned)
+    user_unpin (stack_page, PGSIZE);
+
+  return success;
+}
+
+/* load() helpers. */
+
+#ifndef VM
+static bool install_page (void *upage, void *kpage, bool writable);
+#endif
+
+/* Reads and verifies the ELF executable header and program
+   headers of FILE and stores its entry point and loadable
+   segments in *IMAGE.  Returns true if successful, false if FILE
+   is not an executable we can load. */
+static bool
+read_image (struct file *file, struct exec_image *image) 
+{
+  struct Elf32_Ehdr ehdr;
+  off_t file_ofs;
+  int i;
+
   /* Read and verify executable header. */
+  file_seek (file, 0);
   if (file_read (file, &ehdr, sizeof ehdr) != sizeof ehdr
       || memcmp (ehdr.e_ident, "\177ELF\1\1\1", 7)
       || ehdr.e_type != 2
@@ -266,10 +546,9 @@ load (const char *file_name, void (**eip) (void), void **esp)
       || ehdr.e_version != 1
       || ehdr.e_phentsize != sizeof (struct Elf32_Phdr)
       || ehdr.e_phnum > 1024) 
-    {
-      printf ("load: %s: error loading executable\n", f_name);
-      goto done; 
-    }
+    return false;
+  image->entry = (void (*) (void)) ehdr.e_entry;
+  image->segment_cnt = 0;
 
   /* Read program headers. */
   file_ofs = ehdr.e_phoff;
@@ -278,11 +557,11 @@ load (const char *file_name, void (**eip) (void), void **esp)
       struct Elf32_Phdr phdr;
 
       if (file_ofs < 0 || file_ofs > file_length (file))
-        goto done;
+        return false;
       file_seek (file, file_ofs);
 
       if (file_read (file, &phdr, sizeof phdr) != sizeof phdr)
-        goto done;
+        return false;
       file_ofs += sizeof phdr;
       switch (phdr.p_type) 
         {
@@ -296,116 +575,43 @@ load (const char *file_name, void (**eip) (void), void **esp)
         case PT_DYNAMIC:
         case PT_INTERP:
         case PT_SHLIB:
-          goto done;
+          return false;
         case PT_LOAD:
-          if (validate_segment (&phdr, file)) 
+          if (validate_segment (&phdr, file)
+              && image->segment_cnt < EXEC_SEGMENT_MAX) 
             {
-              bool writable = (phdr.p_flags & PF_W) != 0;
-              uint32_t file_page = phdr.p_offset & ~PGMASK;
-              uint32_t mem_page = phdr.p_vaddr & ~PGMASK;
+              struct exec_segment *seg
+                = &image->segments[image->segment_cnt++];
               uint32_t page_offset = phdr.p_vaddr & PGMASK;
-              uint32_t read_bytes, zero_bytes;
+
+              seg->writable = (phdr.p_flags & PF_W) != 0;
+              seg->file_page = phdr.p_offset & ~PGMASK;
+              seg->upage = (void *) (phdr.p_vaddr & ~PGMASK);
               if (phdr.p_filesz > 0)
                 {
                   /* Normal segment.
                      Read initial part from disk and zero the rest. */
-                  read_bytes = page_offset + phdr.p_filesz;
-                  zero_bytes = (ROUND_UP (page_offset + phdr.p_memsz, PGSIZE)
-                                - read_bytes);
+                  seg->read_bytes = page_offset + phdr.p_filesz;
+                  seg->zero_bytes = (ROUND_UP (page_offset + phdr.p_memsz,
+                                               PGSIZE)
+                                     - seg->read_bytes);
                 }
               else 
                 {
                   /* Entirely zero.
                      Don't read anything from disk. */
-                  read_bytes = 0;
-                  zero_bytes = ROUND_UP (page_offset + phdr.p_memsz, PGSIZE);
+                  seg->read_bytes = 0;
+                  seg->zero_bytes = ROUND_UP (page_offset + phdr.p_memsz,
+                                              PGSIZE);
                 }
-              if (!load_segment (file, file_page, (void *) mem_page,
-                                 read_bytes, zero_bytes, writable))
-                goto done;
             }
           else
-            goto done;
+            return false;
           break;
         }
     }
-
-  int argc = 1, num, argnum;
-  char *arg;
-  char *sep = " ";
-  uint32_t addr[100];
-  char *args[100];
-  void *current_p;
-  /* Set up stack. */
-  if (!setup_stack (esp))
-    {
-      goto done;
-    }
-  else {
-    for (arg = strtok_r(NULL, sep, &brkt);
-	 arg;
-	 argc++, arg = strtok_r(NULL, sep, &brkt))
-      {
-	args[argc] = malloc (strlen (arg) + 1);
-	strlcpy (args[argc], arg, strlen (arg) + 1);
-      }
-    argc--;
-    argnum = argc;
-    args[0] = malloc (strlen (f_name) + 1);
-    strlcpy (args[0], f_name, strlen (f_name) + 1);
-    addr[0] = *esp - (strlen (args[argnum]) + 1);
-
-    // Push arguments to the stack
-    for (num = 0; argnum >= 0;)
-      {
-	strlcpy (addr[num], args[argnum], strlen (args[argnum]) + 1);
-	free (args[argnum]);
-	--argnum; ++num;
-	if (argnum >= 0)
-	  addr[num] = addr[num - 1] - (strlen (args[argnum]) + 1);
-      }
-
-    // memset with 0 to align
-    --num;
-    memset (addr[num] - ((addr[num] % 4)), 0, ((addr[num] % 4)));
-    current_p = addr[num] - ((addr[num] % 4));
-    
-    // null pointer for argv[argc]
-    memset (current_p - 4, 0, 4);
-    current_p -= (sizeof (uint32_t));
-
-    for (i = 0; i <= num ; i++) 
-      {
-	current_p -= (sizeof (uint32_t));
-	*((uint32_t *)current_p) = addr[i];
-      }
-
-    // argv
-    current_p -= (sizeof (uint32_t));
-    *((uint32_t *) current_p ) = current_p + (sizeof (uint32_t));
-    // argc
-    current_p -= (sizeof (uint32_t));
-    *((uint32_t *) current_p ) = argc + 1;
-
-
-    current_p -= (sizeof (uint32_t));
-    *esp = current_p;
-  }
-
-  /* Start address. */
-  *eip = (void (*) (void)) ehdr.e_entry;
-
-  success = true;
-
- done:
-  /* We arrive here whether the load is successful or not. */
-
-  return success;
+  return true;
 }
-
-/* load() helpers. */
-
-static bool install_page (void *upage, void *kpage, bool writable);
 
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
@@ -464,6 +670,9 @@ validate_segment (const struct Elf32_Phdr *phdr, struct file *file)
    The pages initialized by this function must be writable by the
    user process if WRITABLE is true, read-only otherwise.
 
+   With VM, the pages are only registered in the supplemental
+   page table here, and read or zeroed when first touched.
+
    Return true if successful, false if a memory allocation error
    or disk read error occurs. */
 static bool
@@ -474,6 +683,23 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (ofs % PGSIZE == 0);
 
+#ifdef VM
+  while (read_bytes > 0 || zero_bytes > 0) 
+    {
+      size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
+      size_t page_zero_bytes = PGSIZE - page_read_bytes;
+
+      if (!page_add_file (upage, file, ofs, page_read_bytes, writable))
+        return false;
+
+      read_bytes -= page_read_bytes;
+      zero_bytes -= page_zero_bytes;
+      ofs += page_read_bytes;
+      upage += PGSIZE;
+    }
+  return true;
+#else
+
   file_seek (file, ofs);
   while (read_bytes > 0 || zero_bytes > 0) 
     {
@@ -509,6 +735,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       upage += PGSIZE;
     }
   return true;
+#endif
 }
 
 /* Create a minimal stack by mapping a zeroed page at the top of
@@ -516,6 +743,16 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 static bool
 setup_stack (void **esp) 
 {
+#ifdef VM
+  /* The stack is an ordinary zero page, faulted in now so that
+     the arguments can be pushed onto it. */
+  uint8_t *upage = ((uint8_t *) PHYS_BASE) - PGSIZE;
+
+  if (!page_add_zero (upage, true) || !page_fault_in (upage))
+    return false;
+  *esp = PHYS_BASE;
+  return true;
+#else
   uint8_t *kpage;
   bool success = false;
 
@@ -529,8 +766,59 @@ setup_stack (void **esp)
         palloc_free_page (kpage);
     }
   return success;
+#endif
+}
+
+/* Lays out the words of CMD_LINE, separated by spaces, on the
+   stack whose top is *ESP as the arguments to main(): the
+   strings themselves, then argv[], argv, argc, and a null return
+   address, as the 80x86 calling convention expects.  The command
+   line is copied and split into words in a single pass, so the
+   only limit on the arguments is that they must fit in the stack
+   page.  Updates *ESP to the new stack pointer and stores argv[0]
+   in *PROGRAM.  Returns false if there is no program name or the
+   arguments do not fit. */
+static bool
+setup_args (const char *cmd_line, void **esp, char **program) 
+{
+  size_t len = strlen (cmd_line) + 1;
+  size_t argc = 0;
+  char *strings, **argv, *p;
+  const char *c;
+  uint32_t *sp;
+
+  /* Count the words, to know where argv[] goes. */
+  for (c = cmd_line; *c != '\0'; c++)
+    if (*c != ' ' && (c == cmd_line || c[-1] == ' '))
+      argc++;
+  if (argc == 0
+      || (ROUND_UP (len, sizeof *sp) + (argc + 1) * sizeof *argv
+          + 3 * sizeof *sp) > PGSIZE)
+    return false;
+
+  strings = (char *) *esp - len;
+  argv = (char **) ROUND_DOWN ((uintptr_t) strings, sizeof *sp) - (argc + 1);
+
+  /* Copy the command line, ending each word with a null and
+     pointing argv[] at the start of each word. */
+  argc = 0;
+  for (c = cmd_line, p = strings; (*p = *c) != '\0'; c++, p++)
+    if (*c == ' ')
+      *p = '\0';
+    else if (p == strings || p[-1] == '\0')
+      argv[argc++] = p;
+  argv[argc] = NULL;
+
+  sp = (uint32_t *) argv;
+  *--sp = (uint32_t) argv;
+  *--sp = argc;
+  *--sp = 0;
+  *esp = sp;
+  *program = argv[0];
+  return true;
 }
 
+#ifndef VM
 /* Adds a mapping from user virtual address UPAGE to kernel
    virtual address KPAGE to the page table.
    If WRITABLE is true, the user process may modify the page;
@@ -550,3 +838,4 @@ install_page (void *upage, void *kpage, bool writable)
   return (pagedir_get_page (t->pagedir, upage) == NULL
           && pagedir_set_page (t->pagedir, upage, kpage, writable));
 }
+#endif
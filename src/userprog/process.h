@@ -2,12 +2,12 @@
 #define USERPROG_PROCESS_H
 
 #include "threads/thread.h"
-#include "threads/synch.h"
+
+struct intr_frame;
+
 tid_t process_execute (const char *file_name);
+tid_t process_fork (const struct intr_frame *);
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (void);
-bool load_success;
-int child_status;
-struct semaphore load_sema;
 #endif /* userprog/process.h */
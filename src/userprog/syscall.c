@@ -1,107 +1,161 @@
 #include "userprog/syscall.h"
+#include "userprog/pipe.h"
 #include "userprog/process.h"
+#include "userprog/uaccess.h"
 #include "filesys/directory.h"
 #include "filesys/filesys.h"
 #include "filesys/file.h"
+#include <iovec.h>
+#include <limits.h>
+#include <ring.h>
 #include <stdio.h>
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
+#include "threads/sched-trace.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "threads/init.h"
 #include "filesys/off_t.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/cpu.h"
 #include <string.h>
 #include "devices/shutdown.h"
 #include "devices/input.h"
 #include "lib/user/syscall.h"
+#ifdef VM
+#include "vm/mmap.h"
+#endif
+
+/* Longest path accepted from user memory, including its null
+   terminator; handle_sys_create() refuses anything longer. */
+#define PATH_MAX 512
 
-char *read_string (uint32_t);
 struct file *get_file_from_handle (int);
 struct dir *get_dir_from_handle (int);
-void handle_sys_exit (struct intr_frame *, int);
-void handle_sys_create (struct intr_frame *);
-void handle_sys_open (struct intr_frame *);
-void handle_sys_write (struct intr_frame *);
-void handle_sys_read (struct intr_frame *);
-void handle_sys_close (struct intr_frame *);
-void handle_sys_filesize (struct intr_frame *);
-void handle_sys_exec (struct intr_frame *);
-void handle_sys_wait (struct intr_frame *);
-void handle_sys_seek (struct intr_frame *);
-void handle_sys_tell (struct intr_frame *);
-void handle_sys_remove (struct intr_frame *);
-void handle_sys_mkdir (struct intr_frame *);
-void handle_sys_chdir (struct intr_frame *);
-void handle_sys_readdir (struct intr_frame *);
-void handle_sys_isdir (struct intr_frame *);
-void handle_sys_inumber (struct intr_frame *);
-static void syscall_handler (struct intr_frame *);
-
-struct file_descriptor
-{
-  int fd;
-  struct file *file;
-  struct list_elem elem;
-};
 
-struct dir_descriptor
-{
-  int dd;
-  struct dir *dir;
-  struct list_elem elem;
-};
+/* A system call handler.  ARGS holds the call's arguments,
+   already fetched from the user stack and decoded as its table
+   entry specifies.  The handler returns its result in F's eax
+   member. */
+typedef void syscall_func (struct intr_frame *f, uint32_t *args);
+
+static syscall_func handle_sys_halt;
+static syscall_func sys_exit;
+static syscall_func handle_sys_create;
+static syscall_func handle_sys_open;
+static syscall_func handle_sys_write;
+static syscall_func handle_sys_read;
+static syscall_func handle_sys_readv;
+static syscall_func handle_sys_writev;
+static syscall_func handle_sys_pread;
+static syscall_func handle_sys_pwrite;
+static syscall_func handle_sys_ring_setup;
+static syscall_func handle_sys_ring_enter;
+static syscall_func handle_sys_pipe;
+static syscall_func handle_sys_dup2;
+static syscall_func handle_sys_close;
+static syscall_func handle_sys_filesize;
+static syscall_func handle_sys_exec;
+static syscall_func handle_sys_wait;
+static syscall_func handle_sys_seek;
+static syscall_func handle_sys_tell;
+static syscall_func handle_sys_remove;
+static syscall_func handle_sys_mkdir;
+static syscall_func handle_sys_chdir;
+static syscall_func handle_sys_readdir;
+static syscall_func handle_sys_isdir;
+static syscall_func handle_sys_inumber;
+static syscall_func handle_sys_sched_trace;
+#ifdef VM
+static syscall_func handle_sys_fork;
+static syscall_func handle_sys_mmap;
+static syscall_func handle_sys_munmap;
+#endif
+
+/* How a system call argument is fetched and decoded. */
+enum arg_kind
+  {
+    ARG_INT,                    /* Any value, passed as is. */
+    ARG_PTR,                    /* User pointer, which must be below
+                                   PHYS_BASE; the handler checks the
+                                   range it accesses. */
+    ARG_STRING                  /* Null-terminated user string, copied
+                                   into a kernel page; the handler
+                                   gets a kernel `char *'. */
+  };
+
+/* Most arguments a system call takes. */
+#define SYSCALL_MAX_ARGS 4
+
+/* Number of buckets in a latency histogram.  Bucket 0 counts
+   calls that took fewer than 1024 CPU cycles, and each later
+   bucket covers four times the cycles of the one before, except
+   that the last has no upper bound. */
+#define LATENCY_BUCKETS 8
+
+/* A system call table entry. */
+struct syscall
+  {
+    const char *name;                   /* Name, for statistics. */
+    syscall_func *handler;              /* Handler. */
+    int arg_cnt;                        /* Number of arguments. */
+    enum arg_kind args[SYSCALL_MAX_ARGS]; /* How to decode each argument. */
+    int too_long_result;                /* Result if an ARG_STRING does not
+                                           fit in a page. */
+
+    /* Statistics. */
+    unsigned long long call_cnt;        /* # of calls. */
+    unsigned long long latency[LATENCY_BUCKETS]; /* # of calls by cycles. */
+  };
+
+/* System calls, indexed by number. */
+static struct syscall syscalls[] =
+  {
+    [SYS_HALT] = {"halt", handle_sys_halt, 0, {}},
+    [SYS_EXIT] = {"exit", sys_exit, 1, {ARG_INT}},
+    [SYS_EXEC] = {"exec", handle_sys_exec, 1, {ARG_STRING}, -1},
+    [SYS_WAIT] = {"wait", handle_sys_wait, 1, {ARG_INT}},
+    [SYS_CREATE] = {"create", handle_sys_create, 2, {ARG_STRING, ARG_INT},
+                    false},
+    [SYS_REMOVE] = {"remove", handle_sys_remove, 1, {ARG_STRING}, false},
+    [SYS_OPEN] = {"open", handle_sys_open, 1, {ARG_STRING}, -1},
+    [SYS_FILESIZE] = {"filesize", handle_sys_filesize, 1, {ARG_INT}},
+    [SYS_READ] = {"read", handle_sys_read, 3, {ARG_INT, ARG_PTR, ARG_INT}},
+    [SYS_WRITE] = {"write", handle_sys_write, 3, {ARG_INT, ARG_PTR, ARG_INT}},
+    [SYS_SEEK] = {"seek", handle_sys_seek, 2, {ARG_INT, ARG_INT}},
+    [SYS_TELL] = {"tell", handle_sys_tell, 1, {ARG_INT}},
+    [SYS_CLOSE] = {"close", handle_sys_close, 1, {ARG_INT}},
+#ifdef VM
+    [SYS_MMAP] = {"mmap", handle_sys_mmap, 2, {ARG_INT, ARG_INT}},
+    [SYS_MUNMAP] = {"munmap", handle_sys_munmap, 1, {ARG_INT}},
+#endif
+    [SYS_CHDIR] = {"chdir", handle_sys_chdir, 1, {ARG_STRING}, false},
+    [SYS_MKDIR] = {"mkdir", handle_sys_mkdir, 1, {ARG_STRING}, false},
+    [SYS_READDIR] = {"readdir", handle_sys_readdir, 2, {ARG_INT, ARG_PTR}},
+    [SYS_ISDIR] = {"isdir", handle_sys_isdir, 1, {ARG_INT}},
+    [SYS_INUMBER] = {"inumber", handle_sys_inumber, 1, {ARG_INT}},
+    [SYS_SCHED_TRACE] = {"sched_trace", handle_sys_sched_trace, 0, {}},
+#ifdef VM
+    [SYS_FORK] = {"fork", handle_sys_fork, 0, {}},
+#endif
+    [SYS_READV] = {"readv", handle_sys_readv, 3, {ARG_INT, ARG_PTR, ARG_INT}},
+    [SYS_WRITEV] = {"writev", handle_sys_writev, 3,
+                    {ARG_INT, ARG_PTR, ARG_INT}},
+    [SYS_PREAD] = {"pread", handle_sys_pread, 4,
+                   {ARG_INT, ARG_PTR, ARG_INT, ARG_INT}},
+    [SYS_PWRITE] = {"pwrite", handle_sys_pwrite, 4,
+                    {ARG_INT, ARG_PTR, ARG_INT, ARG_INT}},
+    [SYS_RING_SETUP] = {"ring_setup", handle_sys_ring_setup, 1, {ARG_PTR}},
+    [SYS_RING_ENTER] = {"ring_enter", handle_sys_ring_enter, 0, {}},
+    [SYS_PIPE] = {"pipe", handle_sys_pipe, 1, {ARG_PTR}},
+    [SYS_DUP2] = {"dup2", handle_sys_dup2, 2, {ARG_INT, ARG_INT}},
+  };
+
+/* Number of entries in syscalls[]. */
+#define SYSCALL_CNT (sizeof syscalls / sizeof *syscalls)
 
-/* Reads a byte at user virtual address UADDR.
-   UADDR must be below PHYS_BASE.
-   Returns the byte value if successful, -1 if a segfault
-   occurred. */
-static int
-get_user (struct intr_frame *f, const uint8_t *uaddr)
-{
-  int result;
-
-  if ((uint32_t) uaddr <= (uint32_t) PHYS_BASE)
-    {
-      asm ("movl $1f, %0; movzbl %1, %0; 1:"
-	   : "=&a" (result) : "m" (*uaddr));
-      return result;
-    }
-  handle_sys_exit (f, -1);
-  return -1;
-}
- 
-/* Writes BYTE to user address UDST.
-   UDST must be below PHYS_BASE.
-   Returns true if successful, false if a segfault occurred. */
-static bool
-put_user (struct intr_frame *f, uint8_t *udst, uint8_t byte)
-{
-  int error_code;
-  if ((uint32_t) udst <= (uint32_t) PHYS_BASE)
-    {
-      asm ("movl $1f, %0; movb %b2, %1; 1:"
-	   : "=&a" (error_code), "=m" (*udst) : "q" (byte));
-      return error_code != -1;
-    }
-  handle_sys_exit (f, -1);
-  return false;
-}
- 
-char *read_string (uint32_t addr)
-{
-  char *file_name;
-  int i;
-  file_name = malloc (sizeof (char) * 100);
-  for (i = 0; i < 100; i++)
-    {
-      file_name[i] = *(char *)(addr + i);
-      if (file_name[i] == '\0')
-      	break;
-    }
-  return file_name;
-}
 void
 syscall_init (void) 
 {
@@ -111,241 +165,260 @@ syscall_init (void)
 void
 handle_sys_exit (struct intr_frame *f, int status)
 {
-  uint32_t *searcher, ARG0;
-  int ofs, i;
-  char *buffer, *exit_message, *brkt;
+  char *name, *exit_message, *brkt;
   size_t exit_message_size;
-  struct list *list;
-  struct list_elem *e;
-  struct file_descriptor *cur;
-  struct dir_descriptor *cur_dir;
-  if (status == (int) NULL)
-    {
-      if (f->esp + (sizeof (uint32_t) * 2) > PHYS_BASE)
-	handle_sys_exit (f, -1);
-      ARG0 = *(uint32_t *) (f->esp + (sizeof (uint32_t)));
-    }
-  list = &(thread_current ()->file_descriptors);
-  
-  for (e = list_begin (list); e != list_end (list);)
-    {
-      cur = list_entry (e, struct file_descriptor, elem);
-      e = list_next (e);
-      file_close (cur->file);
-      list_remove (&cur->elem);
-      free (cur);
-    }
 
-  list = &(thread_current ()->dir_descriptors);
-  
-  for (e = list_begin (list); e != list_end (list);)
+  name = strtok_r (thread_current ()->name, " ", &brkt);
+  exit_message_size = sizeof (char) * (strlen (name) + 15);
+  exit_message = malloc (exit_message_size);
+  if (exit_message != NULL)
     {
-      cur_dir = list_entry (e, struct dir_descriptor, elem);
-      e = list_next (e);
-      dir_close (cur_dir->dir);
-      list_remove (&cur_dir->elem);
-      free (cur_dir);
+      snprintf (exit_message, exit_message_size,
+                "%s: exit(%d)\n", name, status);
+      putbuf (exit_message, strlen (exit_message));
+      free (exit_message);
     }
 
-  for (searcher = PHYS_BASE; *searcher != 0; --searcher) ;
-  searcher++;
-  for (ofs = 0; 
-       ofs < 4 
-	 && get_user (f, (void *)searcher + ofs) == 0; 
-       ofs++) ;
-  
-  /* buffer = malloc (100 * sizeof (char)); */
-  /* for (i = 0; i < 100; i++) */
-  /*   { */
-  /*     buffer[i] = get_user (f, (uint8_t *)  */
-  /* 			    (ofs + i + (uint32_t) searcher)); */
-  /*     if (buffer[i] == '\0') */
-  /* 	break; */
-  /*   } */
-  /* free (buffer); */
-  buffer = strtok_r (thread_current ()->name, " ", &brkt);
-  exit_message_size = sizeof (char) * (strlen(buffer) + 15);
-  exit_message = malloc (exit_message_size);
-  if (status == (int) NULL)
-    status = ARG0;
-  snprintf (exit_message, exit_message_size,
-  	    "%s: exit(%d)\n", buffer, status);
-  putbuf (exit_message, strlen (exit_message));
-
-  free (exit_message);
   f->eax = status;
   thread_current ()->exit_status = status;
   thread_exit ();
 }
 
-void
-handle_sys_write (struct intr_frame *f)
+/* Returns true if the CNT buffers in IOV all lie in user address
+   space and their total size fits in an int. */
+static bool
+iov_ok (const struct iovec *iov, int cnt)
 {
-  uint32_t ARG0, ARG1, ARG2;
-  uint8_t *buffer;
+  size_t total = 0;
   int i;
 
-  ARG0 = *(uint32_t *) (f->esp + (sizeof (uint32_t)));
-  ARG1 = *(uint32_t *) (f->esp + (sizeof (uint32_t) * 2));
-  ARG2 = *(uint32_t *) (f->esp + (sizeof (uint32_t) * 3));
-
-  struct file *file = NULL;
-
-  if (ARG1 + ARG2 > (uint32_t) PHYS_BASE)
-    handle_sys_exit (f, -1);
-
-  buffer = malloc (ARG2);
-  for (i = 0; i < (int) ARG2; i++)
+  for (i = 0; i < cnt; i++)
     {
-      buffer[i] = get_user (f, (uint8_t *)(ARG1 + i));
+      if (!user_range_ok (iov[i].iov_base, iov[i].iov_len)
+          || iov[i].iov_len > INT_MAX - total)
+        return false;
+      total += iov[i].iov_len;
     }
+  return true;
+}
+
+/* Reads into or, if WRITE, writes from the CNT pinned buffers in
+   IOV, using FILE at offset OFS, or at its current position if
+   OFS is negative, or using PIPE.  If both are null, uses the
+   console.  Returns the number of bytes transferred. */
+static off_t
+transfer (struct file *file, struct pipe *pipe, const struct iovec *iov,
+          int cnt, off_t ofs, bool write)
+{
+  off_t bytes = 0;
+  int i;
 
-  if (ARG0 == 1)
+  if (pipe != NULL)
     {
-      putbuf ((char *) buffer, ARG2);
-      f->eax = ARG2;
+      /* Only wait for the first byte of a read, so that a read
+         returns whatever the writer has supplied so far. */
+      for (i = 0; i < cnt; i++)
+        {
+          size_t n = (write
+                      ? pipe_write (pipe, iov[i].iov_base, iov[i].iov_len)
+                      : pipe_read (pipe, iov[i].iov_base, iov[i].iov_len,
+                                   bytes == 0));
+          bytes += n;
+          if (n < iov[i].iov_len)
+            break;
+        }
+      return bytes;
     }
-  else if (ARG0 == 0)
-    handle_sys_exit (f, -1);
-  else
+  else if (file != NULL && write)
+    return (ofs < 0 ? file_writev (file, iov, cnt)
+            : file_writev_at (file, iov, cnt, ofs));
+  else if (file != NULL)
+    return (ofs < 0 ? file_readv (file, iov, cnt)
+            : file_readv_at (file, iov, cnt, ofs));
+
+  for (i = 0; i < cnt; i++)
     {
-      file = get_file_from_handle ((int) ARG0);
-      if (file == NULL)
-	f->eax = -1;
+      uint8_t *buffer = iov[i].iov_base;
+      size_t j;
+
+      if (write)
+        putbuf ((const char *) buffer, iov[i].iov_len);
       else
-	f->eax = file_write (file, buffer, ARG2);
+        for (j = 0; j < iov[i].iov_len; j++)
+          buffer[j] = input_getc ();
+      bytes += iov[i].iov_len;
     }
-
-  free (buffer);
+  return bytes;
 }
-void
-handle_sys_create (struct intr_frame *f)
+
+/* Unpins the CNT buffers in IOV. */
+static void
+unpin_iov (const struct iovec *iov, int cnt)
 {
-  char *file_path, *name;
-  struct inode *inode = NULL;
-  uint32_t ARG1, ARG2;
   int i;
 
-  ARG1 = *(uint32_t *) (f->esp + (sizeof (uint32_t)));
-  ARG2 = *(uint32_t *) (f->esp + (sizeof (uint32_t)*2));
-  
-  if (ARG1 == (uint32_t) NULL)
+  for (i = 0; i < cnt; i++)
+    user_unpin (iov[i].iov_base, iov[i].iov_len);
+}
+
+/* Reads from FILE into the CNT user buffers in IOV, which
+   iov_ok() has accepted, or, if WRITE, writes them to FILE, at
+   offset OFS or, if OFS is negative, at FILE's current position.
+   If FILE is null, uses PIPE instead, or the console if PIPE is
+   also null.  The buffers are pinned and handed to the file
+   system or pipe directly, in batches of at most USER_PIN_MAX
+   bytes, so that no kernel copy is made and a huge buffer cannot
+   pin all of memory.  A pipe read stops after the first batch,
+   since it would otherwise wait for more data.  Returns the
+   number of bytes transferred, or -1 if a buffer is not
+   accessible, in which case nothing is left pinned. */
+static int
+user_io (struct file *file, struct pipe *pipe, const struct iovec *iov,
+         int cnt, off_t ofs, bool write)
+{
+  struct iovec batch[IOV_MAX];
+  size_t seg_ofs = 0;
+  int total = 0;
+  int i = 0;
+
+  while (i < cnt)
     {
-      handle_sys_exit (f, -1);
-      return;
+      size_t batch_size = 0;
+      int batch_cnt = 0;
+      off_t n;
+
+      while (i < cnt && batch_cnt < IOV_MAX && batch_size < USER_PIN_MAX)
+        {
+          uint8_t *base = (uint8_t *) iov[i].iov_base + seg_ofs;
+          size_t size = iov[i].iov_len - seg_ofs;
+
+          if (size > USER_PIN_MAX - batch_size)
+            size = USER_PIN_MAX - batch_size;
+          if (size > 0)
+            {
+              if (!user_pin (base, size, !write))
+                {
+                  unpin_iov (batch, batch_cnt);
+                  return -1;
+                }
+              batch[batch_cnt].iov_base = base;
+              batch[batch_cnt].iov_len = size;
+              batch_cnt++;
+              batch_size += size;
+              seg_ofs += size;
+            }
+          if (seg_ofs == iov[i].iov_len)
+            {
+              i++;
+              seg_ofs = 0;
+            }
+        }
+
+      n = transfer (file, pipe, batch, batch_cnt, ofs, write);
+      unpin_iov (batch, batch_cnt);
+      total += n;
+      if (ofs >= 0)
+        ofs += n;
+      if ((size_t) n < batch_size || (pipe != NULL && !write))
+        break;
     }
+  return total;
+}
+
+/* Looks up descriptor FD of the current process for reading or,
+   if WRITE, for writing.  Stores the file or pipe end it refers
+   to in *FILE or *PIPE and a null pointer in the other, or null
+   pointers in both if FD is the console.  Returns false if FD
+   cannot be used that way. */
+static bool
+get_stream (int fd, bool write, struct file **file, struct pipe **pipe)
+{
+  struct fd_table *fds = &thread_current ()->fds;
+
+  *file = fd_get_file (fds, fd);
+  *pipe = fd_get_pipe (fds, fd, write);
+  if (*file != NULL || *pipe != NULL)
+    return true;
+  return (fd == (write ? STDOUT_FILENO : STDIN_FILENO)
+          && !fd_is_open (fds, fd));
+}
 
-  file_path = malloc (sizeof (char) * 100);
-  for (i = 0; i < 100; i++)
+static void
+handle_sys_write (struct intr_frame *f, uint32_t *args)
+{
+  uint32_t fd;
+  struct iovec iov;
+  fd = args[0];
+  iov.iov_base = (void *) args[1];
+  iov.iov_len = args[2];
+  struct file *file;
+  struct pipe *pipe;
+
+  if (!iov_ok (&iov, 1))
+    handle_sys_exit (f, -1);
+
+  if (!get_stream (fd, true, &file, &pipe))
     {
-      file_path[i] = get_user (f, (uint8_t *) (ARG1 + i));
-      if (file_path[i] == '\0')
-      	break;
+      if (fd == STDIN_FILENO)
+        handle_sys_exit (f, -1);
+      f->eax = -1;
+      return;
     }
-  if (strlen (file_path) == 0)
+
+  f->eax = user_io (file, pipe, &iov, 1, -1, true);
+  if ((int) f->eax < 0)
+    handle_sys_exit (f, -1);
+}
+
+static void
+handle_sys_create (struct intr_frame *f, uint32_t *args)
+{
+  char *file_path = (char *) args[0];
+  char *name;
+  struct inode *inode = NULL;
+
+  if (strlen (file_path) == 0 || strlen (file_path) >= 511)
     f->eax = false;
   else
     {
-      if (strlen (file_path) >= 511)
-	f->eax = false;
+      struct dir *d;
+      d = dir_get (file_path);
+      name = get_filename (file_path);
+      if (is_dir (file_path)
+          || !d
+          || dir_lookup (d, name, &inode))
+        {
+          f->eax = false;
+        }
       else
-	{
-	  struct dir *d;
-	  d = dir_get (file_path);
-	  name = get_filename (file_path);
-	  if (is_dir (file_path)
-	      || !d
-	      || dir_lookup (d, name, &inode))
-	    {
-	      f->eax = false;
-	    }
-	  else
-	    {
-	      f->eax = filesys_create (file_path, ARG2);
-	    }
-	  free (name);
-	  dir_close (d);
-	  inode_close (inode);
-	}
+        {
+          f->eax = filesys_create (file_path, args[1]);
+        }
+      free (name);
+      dir_close (d);
+      inode_close (inode);
     }
-  free (file_path);
 }
 
-void 
-handle_sys_open (struct intr_frame *f)
+/* Opens the file or directory named PATH in the current process
+   and returns its descriptor, or -1 on failure. */
+static int
+open_path (char *path)
 {
+  struct fd_table *fds = &thread_current ()->fds;
   struct file *file;
-  uint32_t ARG0;
-  char *path;
-  struct file_descriptor * file_descriptor, *last;
-  struct dir_descriptor * dir_descriptor, *last_dir;
   struct dir *dir;
-  struct list *list;
-
-  ARG0 = *(uint32_t *) (f->esp + (sizeof (uint32_t)));
+  int fd = -1;
 
-  if (ARG0 == 0)
-    {
-      handle_sys_exit (f, -1);
-      return;
-    }
-  
-  path = read_string (ARG0);
   if (strlen (path) == 0)
-    {
-      f->eax = -1;
-      return;
-    }
+    return -1;
 
   file = filesys_open (path);
   if (file != NULL)
     {
-      file_descriptor = malloc (sizeof (struct file_descriptor));
-      file_descriptor->file = file;
-      if (list_empty (&thread_current ()->file_descriptors))
-      	{
-	  if (list_empty (&thread_current ()->dir_descriptors))
-	    {
-	      file_descriptor->fd = 2;
-	      list_push_back (&thread_current ()->file_descriptors,
-			      &file_descriptor->elem);
-	      f->eax = 2;
-	    }
-	  else
-	    {
-	      last_dir = list_entry (list_rbegin (&thread_current ()->dir_descriptors)
-				     , struct dir_descriptor, elem);
-	      file_descriptor->fd = last_dir->dd + 1;
-	      list_push_back (&thread_current ()->file_descriptors,
-			      &file_descriptor->elem);
-	      f->eax = file_descriptor->fd;
-	    }
-      	}
-      else
-      	{
-	  if (list_empty (&thread_current ()->dir_descriptors))
-	    {
-	      last = list_entry (list_rbegin (&thread_current ()->file_descriptors)
-				     , struct file_descriptor, elem);
-	      file_descriptor->fd = last->fd + 1;
-	      list_push_back (&thread_current ()->file_descriptors,
-			      &file_descriptor->elem);
-	      f->eax = file_descriptor->fd;
-
-	    }
-	  else
-	    {
-	      list = &(thread_current ()->file_descriptors);
-	      last = list_entry (list_rbegin (list), struct file_descriptor, elem);
-	      last_dir = list_entry (list_rbegin (&thread_current ()->dir_descriptors)
-				     , struct dir_descriptor, elem);
-	      file_descriptor->fd = (last->fd > last_dir->dd 
-				     ? last->fd : last_dir->dd) + 1;
-	      list_push_back (list,
-			      &file_descriptor->elem);
-	      f->eax = file_descriptor->fd;
-	    }
-      	}
+      fd = fd_open_file (fds, file);
+      if (fd == -1)
+	file_close (file);
     }
   else if (is_dir (path))
     {
@@ -353,267 +426,336 @@ handle_sys_open (struct intr_frame *f)
       if (strlen (path) &&
 	  (strcmp (path, "/") == 0 || is_dir (path)))
 	{
-	  dir_descriptor = malloc (sizeof (struct dir_descriptor));
-	  dir_descriptor->dir = dir;
-	  if (list_empty (&thread_current ()->dir_descriptors))
-	    {
-	      if (list_empty (&thread_current ()->file_descriptors))
-		{
-		  dir_descriptor->dd = 2;
-		  list_push_back (&thread_current ()->dir_descriptors,
-				  &dir_descriptor->elem);
-		  f->eax = 2;
-		}
-	      else
-		{
-		  last = list_entry (list_rbegin (&thread_current ()->file_descriptors)
-					 , struct file_descriptor, elem);
-		  dir_descriptor->dd = last->fd + 1;
-		  list_push_back (&thread_current ()->dir_descriptors,
-				  &dir_descriptor->elem);
-		  f->eax = dir_descriptor->dd;
-		}
-	    }
-	  else
-	    {
-	      if (list_empty (&thread_current ()->file_descriptors))
-		{
-		  last_dir = list_entry (list_rbegin 
-					 (&thread_current ()->dir_descriptors)
-				     , struct dir_descriptor, elem);
-		  dir_descriptor->dd = last_dir->dd + 1;
-		  list_push_back (&thread_current ()->dir_descriptors,
-				  &dir_descriptor->elem);
-		  f->eax = dir_descriptor->dd;
-		}
-	      else
-		{
-		  list = &(thread_current ()->dir_descriptors);
-		  last_dir = list_entry (list_rbegin (list), 
-					 struct dir_descriptor, elem);
-		  last = list_entry (list_rbegin (&thread_current ()->file_descriptors)
-				     , struct file_descriptor, elem);
-		  dir_descriptor->dd = (last->fd > last_dir->dd 
-					? last->fd : last_dir->dd) + 1;
-		  list_push_back (list,
-				  &dir_descriptor->elem);
-		  f->eax = dir_descriptor->dd;
-		}
-	    }
+	  fd = fd_open_dir (fds, dir);
+	  if (fd == -1)
+	    dir_close (dir);
 	}
-      else
-	f->eax = -1;
-
     }
+  return fd;
+}
+
+static void
+handle_sys_open (struct intr_frame *f, uint32_t *args)
+{
+  f->eax = open_path ((char *) args[0]);
+}
+
+static void
+handle_sys_close (struct intr_frame *f, uint32_t *args)
+{
+  if (fd_close (&thread_current ()->fds, args[0]))
+    f->eax = true;
   else
-    f->eax = -1;
+    handle_sys_exit (f, -1);
+}
 
-  free (path);
+struct file *
+get_file_from_handle (int fd)
+{
+  return fd_get_file (&thread_current ()->fds, fd);
 }
 
-void
-handle_sys_close (struct intr_frame *f)
+struct dir *
+get_dir_from_handle (int dd)
 {
-  uint32_t ARG0;
-  ARG0 = *(uint32_t *) (f->esp + (sizeof (uint32_t)));
+  return fd_get_dir (&thread_current ()->fds, dd);
+}
 
-  if (ARG0 < 2)
+static void
+handle_sys_read (struct intr_frame *f, uint32_t *args)
+{
+  uint32_t fd;
+  struct iovec iov;
+  fd = args[0];
+  iov.iov_base = (void *) args[1];
+  iov.iov_len = args[2];
+  struct file *file;
+  struct pipe *pipe;
+
+  if (!iov_ok (&iov, 1) || !get_stream (fd, false, &file, &pipe))
     handle_sys_exit (f, -1);
 
-  struct thread *cur = thread_current ();
-  struct list *list = &cur->file_descriptors;
-  struct dir_descriptor *dir_desc;
-  struct file_descriptor *file_desc;
-  struct list_elem *e;
+  f->eax = user_io (file, pipe, &iov, 1, -1, false);
+  if ((int) f->eax < 0)
+    handle_sys_exit (f, -1);
+}
 
-  for (e = list_begin (list); e != list_end (list);
-       e = list_next (e))
+/* Common code for readv() and writev(). */
+static void
+sys_vector_io (struct intr_frame *f, uint32_t *args, bool write)
+{
+  uint32_t fd, uiov, cnt;
+  struct iovec iov[IOV_MAX];
+  struct file *file;
+  struct pipe *pipe;
+  fd = args[0];
+  uiov = args[1];
+  cnt = args[2];
+
+  if (cnt > IOV_MAX)
     {
-      file_desc = list_entry (e, struct file_descriptor, elem);
-      if (file_desc->fd == (int) ARG0)
-	{
-	  file_close (file_desc->file);
-	  list_remove (&file_desc->elem);
-	  free (file_desc);
-	  f->eax = true;
-	  return;
-	}
+      f->eax = -1;
+      return;
     }
+  if (!copy_from_user (iov, (void *) uiov, cnt * sizeof *iov)
+      || !iov_ok (iov, cnt))
+    handle_sys_exit (f, -1);
 
-  list = &cur->dir_descriptors;
-
-  for (e = list_begin (list); e != list_end (list);
-       e = list_next (e))
+  if (!get_stream (fd, write, &file, &pipe))
     {
-      dir_desc = list_entry (e, struct dir_descriptor, elem);
-      if (dir_desc->dd == (int) ARG0)
-	{
-	  dir_close (dir_desc->dir);
-	  list_remove (&dir_desc->elem);
-	  free (dir_desc);
-	  f->eax = true;
-	  return;
-	}
+      f->eax = -1;
+      return;
     }
-  handle_sys_exit (f, -1);
+
+  f->eax = user_io (file, pipe, iov, cnt, -1, write);
+  if ((int) f->eax < 0)
+    handle_sys_exit (f, -1);
 }
 
-struct file *
-get_file_from_handle (int fd)
+static void
+handle_sys_readv (struct intr_frame *f, uint32_t *args)
 {
-  struct thread *cur = thread_current ();
-  struct list *list = &cur->file_descriptors;
-  struct file_descriptor *file_desc;
-  struct list_elem *e;
-  struct file *file = NULL;
-  for (e = list_begin (list); e != list_end (list);
-       e = list_next (e))
-    {
-      file_desc = list_entry (e, struct file_descriptor, elem);
-      if (file_desc->fd == (int) fd)
-	{
-	  file = file_desc->file;
-	  break;
-	}
-    }
-  return file;
+  sys_vector_io (f, args, false);
 }
 
-struct dir *
-get_dir_from_handle (int dd)
+static void
+handle_sys_writev (struct intr_frame *f, uint32_t *args)
 {
-  struct thread *cur = thread_current ();
-  struct list *list = &cur->dir_descriptors;
-  struct dir_descriptor *dir_descriptor;
-  struct list_elem *e;
-  struct file *dir = NULL;
-  for (e = list_begin (list); e != list_end (list);
-       e = list_next (e))
-    {
-      dir_descriptor = list_entry (e, struct file_descriptor, elem);
-      if (dir_descriptor->dd == (int) dd)
-	{
-	  dir = dir_descriptor->dir;
-	  break;
-	}
-    }
-  return dir;
+  sys_vector_io (f, args, true);
 }
 
-void
-handle_sys_read (struct intr_frame *f)
+/* Common code for pread() and pwrite(). */
+static void
+sys_positional_io (struct intr_frame *f, uint32_t *args, bool write)
 {
-  uint32_t fd, buffer, size, _size;
-  fd = *(uint32_t *) (f->esp + (sizeof (uint32_t)));
-  buffer = *(uint32_t *) (f->esp + (sizeof (uint32_t)) * 2);
-  size = *(uint32_t *) (f->esp + (sizeof (uint32_t)) * 3);
-  _size = size;
-  int i;
-  struct file *file = NULL;
+  uint32_t fd;
+  off_t ofs;
+  struct iovec iov;
+  struct file *file;
+  fd = args[0];
+  iov.iov_base = (void *) args[1];
+  iov.iov_len = args[2];
+  ofs = (int32_t) args[3];
 
-  if (buffer + size > (uint32_t) PHYS_BASE)
+  if (!iov_ok (&iov, 1))
     handle_sys_exit (f, -1);
-  char *buffer_temp = malloc (size);
 
   file = get_file_from_handle (fd);
-  if (file == NULL && fd != 0)
+  if (file == NULL || ofs < 0)
+    {
+      f->eax = -1;
+      return;
+    }
+
+  f->eax = user_io (file, NULL, &iov, 1, ofs, write);
+  if ((int) f->eax < 0)
     handle_sys_exit (f, -1);
+}
 
-  if (fd == 0)
+static void
+handle_sys_pread (struct intr_frame *f, uint32_t *args)
+{
+  sys_positional_io (f, args, false);
+}
+
+static void
+handle_sys_pwrite (struct intr_frame *f, uint32_t *args)
+{
+  sys_positional_io (f, args, true);
+}
+
+/* Registers the ring at user address ARGS[0] as the current
+   process's submission ring, replacing any earlier one. */
+static void
+handle_sys_ring_setup (struct intr_frame *f, uint32_t *args)
+{
+  struct ring *ring;
+  ring = (struct ring *) args[0];
+
+  if (ring == NULL || (uintptr_t) ring % sizeof (unsigned) != 0
+      || !user_range_ok (ring, sizeof *ring))
     {
-      for (i = 0; i < (int) size; i++)
-	put_user (f, (void *) buffer + i, input_getc ());
+      f->eax = false;
+      return;
     }
-  else
+  thread_current ()->ring = ring;
+  f->eax = true;
+}
+
+/* Carries out submitted operation SQE for the current process
+   and returns its result.  Unlike the corresponding system
+   calls, a bad pointer or descriptor just fails the operation,
+   rather than killing the process. */
+static int
+ring_execute (const struct ring_sqe *sqe)
+{
+  struct file *file = get_file_from_handle (sqe->fd);
+  struct pipe *pipe;
+  struct iovec iov;
+  char *path;
+  int result;
+
+  switch (sqe->op)
     {
-      _size = file_read (file, buffer, size);
-    }
-  
-  /* for (i = 0; i < (int) size; i++) */
-  /*   { */
-  /*     put_user (f, (void *) buffer + i, buffer_temp[i]); */
-  /*   } */
+    case RING_NOP:
+      return 0;
+
+    case RING_READ:
+    case RING_WRITE:
+      iov.iov_base = sqe->buf;
+      iov.iov_len = sqe->len;
+      if (!iov_ok (&iov, 1)
+          || !get_stream (sqe->fd, sqe->op == RING_WRITE, &file, &pipe))
+        return -1;
+      return user_io (file, pipe, &iov, 1, -1, sqe->op == RING_WRITE);
+
+    case RING_OPEN:
+      path = malloc (PATH_MAX);
+      if (path == NULL)
+        return -1;
+      result = (copy_string_from_user (path, sqe->buf, PATH_MAX)
+                == COPY_STRING_OK ? open_path (path) : -1);
+      free (path);
+      return result;
+
+    case RING_CLOSE:
+      return fd_close (&thread_current ()->fds, sqe->fd) ? 0 : -1;
 
-  free (buffer_temp);
-  f->eax = _size;
+    case RING_SEEK:
+      if (file == NULL)
+        return -1;
+      file_seek (file, sqe->ofs);
+      return 0;
+
+    default:
+      return -1;
+    }
 }
 
-void
-handle_sys_filesize (struct intr_frame *f)
+/* Carries out the operations queued in the current process's
+   submission ring, in order, until the submission queue is empty
+   or the completion queue is full, posting a completion for
+   each.  The ring stays pinned throughout, so one trap handles a
+   whole batch at the cost of pinning it once.  Returns the number
+   of operations carried out, or -1 if no ring is registered. */
+static void
+handle_sys_ring_enter (struct intr_frame *f, uint32_t *args UNUSED)
 {
-  uint32_t fd;
-  fd = *(uint32_t *) (f->esp + (sizeof (uint32_t)));
+  struct ring *ring = thread_current ()->ring;
+  int cnt = 0;
 
-  struct thread *cur = thread_current ();
-  struct list *list = &cur->file_descriptors;
-  struct file_descriptor *file_desc;
-  struct list_elem *e;
-  struct file *file = NULL;
-  for (e = list_begin (list); e != list_end (list);
-       e = list_next (e))
+  if (ring == NULL)
     {
-      file_desc = list_entry (e, struct file_descriptor, elem);
-      if (file_desc->fd == (int) fd)
-	{
-	  file = file_desc->file;
-	  f->eax = file_length (file);
-	  return;
-	}
+      f->eax = -1;
+      return;
     }
+  if (!user_pin (ring, sizeof *ring, true))
+    handle_sys_exit (f, -1);
 
-  f->eax = false;
- }
-void
-handle_sys_exec (struct intr_frame *f)
+  while (cnt < RING_ENTRIES
+         && ring->sq_head != ring->sq_tail
+         && ring->cq_tail - ring->cq_head < RING_ENTRIES)
+    {
+      /* Copy the submission first, so that the process cannot
+         change it while it is being carried out. */
+      struct ring_sqe sqe = ring->sq[ring->sq_head % RING_ENTRIES];
+      struct ring_cqe *cqe = &ring->cq[ring->cq_tail % RING_ENTRIES];
+
+      ring->sq_head++;
+      cqe->user_data = sqe.user_data;
+      cqe->res = ring_execute (&sqe);
+      ring->cq_tail++;
+      cnt++;
+    }
+
+  user_unpin (ring, sizeof *ring);
+  f->eax = cnt;
+}
+
+/* Creates a pipe and stores descriptors for its read and write
+   ends in the two ints at user address ARGS[0]. */
+static void
+handle_sys_pipe (struct intr_frame *f, uint32_t *args)
 {
-  uint32_t ARG0;
-  ARG0 = *(uint32_t *) (f->esp + (sizeof (uint32_t)));
-  char *cmd_line;
-  struct list_elem *e;
-  tid_t child_tid;
-  int i;
+  struct fd_table *fds = &thread_current ()->fds;
+  int *ufds = (int *) args[0];
+  struct pipe *pipe;
+  int pipe_fds[2];
+
+  if (!user_range_ok (ufds, sizeof pipe_fds))
+    handle_sys_exit (f, -1);
 
-  cmd_line = malloc (100);
-  for (i = 0; i < 100; i++)
+  f->eax = false;
+  pipe = pipe_create ();
+  if (pipe == NULL)
+    return;
+  pipe_fds[0] = fd_open_pipe (fds, pipe, false);
+  if (pipe_fds[0] == -1)
     {
-      cmd_line[i] = get_user (f, (uint8_t *)(ARG0 + i));
-      if (cmd_line[i] == '\0')
-	break;
+      pipe_close (pipe, false);
+      pipe_close (pipe, true);
+      return;
+    }
+  pipe_fds[1] = fd_open_pipe (fds, pipe, true);
+  if (pipe_fds[1] == -1)
+    {
+      fd_close (fds, pipe_fds[0]);
+      pipe_close (pipe, true);
+      return;
     }
 
-  child_tid = process_execute (cmd_line);
-
-  for (e = list_begin (&all_list); e != list_end (&all_list);
-       e = list_next (e))
+  if (!copy_to_user (ufds, pipe_fds, sizeof pipe_fds))
     {
-      struct thread *t = list_entry (e, struct thread, allelem);
-      if (t->tid == child_tid)
-	sema_down (&t->load);
-    } 
+      fd_close (fds, pipe_fds[0]);
+      fd_close (fds, pipe_fds[1]);
+      handle_sys_exit (f, -1);
+    }
+  f->eax = true;
+}
 
-  free (cmd_line);
-  if (!load_success || child_tid == TID_ERROR)
-    f->eax = -1;
+/* Makes descriptor ARGS[1] refer to what descriptor ARGS[0]
+   does. */
+static void
+handle_sys_dup2 (struct intr_frame *f, uint32_t *args)
+{
+  f->eax = fd_dup2 (&thread_current ()->fds, args[0], args[1]);
+}
+
+static void
+handle_sys_filesize (struct intr_frame *f, uint32_t *args)
+{
+  uint32_t fd;
+  fd = args[0];
+
+  struct file *file = get_file_from_handle (fd);
+  if (file != NULL)
+    f->eax = file_length (file);
   else
-    f->eax = child_tid;
+    f->eax = false;
+}
+static void
+handle_sys_exec (struct intr_frame *f, uint32_t *args)
+{
+  char *cmd_line = (char *) args[0];
 
+  f->eax = process_execute (cmd_line);
 }
 
-void 
-handle_sys_wait (struct intr_frame *f)
+static void
+handle_sys_wait (struct intr_frame *f, uint32_t *args)
 {
   tid_t child_tid;
-  child_tid = *(uint32_t *) (f->esp + (sizeof (uint32_t)));
+  child_tid = args[0];
   
   f->eax = process_wait (child_tid);
 }
 
-void 
-handle_sys_seek (struct intr_frame *f)
+static void
+handle_sys_seek (struct intr_frame *f, uint32_t *args)
 {
   uint32_t handle, position;
-  handle = *(uint32_t *) (f->esp + (sizeof (uint32_t)));
-  position  = *(uint32_t *) (f->esp + (sizeof (uint32_t)) * 2);
+  handle = args[0];
+  position  = args[1];
 
   struct file *file = get_file_from_handle (handle);
   if (file == NULL)
@@ -622,11 +764,11 @@ handle_sys_seek (struct intr_frame *f)
     file_seek (file, position);
 }
 
-void
-handle_sys_tell (struct intr_frame *f)
+static void
+handle_sys_tell (struct intr_frame *f, uint32_t *args)
 {
   uint32_t handle;
-  handle = *(uint32_t *) (f->esp + (sizeof (uint32_t)));
+  handle = args[0];
 
   struct file *file = get_file_from_handle (handle);
   if (file == NULL)
@@ -635,23 +777,13 @@ handle_sys_tell (struct intr_frame *f)
     f->eax = file_tell (file);
 }
 
-void
-handle_sys_remove (struct intr_frame *f)
+static void
+handle_sys_remove (struct intr_frame *f, uint32_t *args)
 {
-  uint32_t fname_ptr;
-  fname_ptr = *(uint32_t *) (f->esp + (sizeof (uint32_t)));
+  char *path = (char *) args[0];
   struct dir *dir;
-  char *path, *name;
+  char *name;
   struct inode *inode;
-  int i;
-
-  path = malloc (100);
-  for (i = 0; i < 100; i++)
-    {
-      path[i] = get_user (f, (uint8_t *)(fname_ptr + i));
-      if (path[i] == '\0')
-	break;
-    }
 
   dir = dir_get (path);
   name = get_filename (path);
@@ -665,76 +797,43 @@ handle_sys_remove (struct intr_frame *f)
 
    dir_close (dir);
    free (name);
-   free (path);
 }
 
-void
-handle_sys_mkdir (struct intr_frame *f)
+static void
+handle_sys_mkdir (struct intr_frame *f, uint32_t *args)
 {
-  uint32_t dir_name_ptr;
-  dir_name_ptr = *(uint32_t *) (f->esp + (sizeof (uint32_t)));
-
-  char *dir_name;
-  int i;
+  char *dir_name = (char *) args[0];
 
-  dir_name = malloc (NAME_MAX + 1);
-  for (i = 0; i < 100; i++)
-    {
-      dir_name[i] = get_user (f, (uint8_t *) (dir_name_ptr + i));
-      if (dir_name[i] == '\0')
-	break;
-    }
   if (dir_name[0] == '\0')
     f->eax = 0;
   else
     f->eax = dir_mkdir (dir_name);
-  free (dir_name);
 }
 
-void
-handle_sys_chdir (struct intr_frame *f)
+static void
+handle_sys_chdir (struct intr_frame *f, uint32_t *args)
 {
-  uint32_t dir_name_ptr;
-  dir_name_ptr = *(uint32_t *) (f->esp + (sizeof (uint32_t)));
-
-  char *dir_name;
-  int i;
-
-  dir_name = malloc (NAME_MAX + 1);
-  for (i = 0; i < 100; i++)
-    {
-      dir_name[i] = get_user (f, (uint8_t *) (dir_name_ptr + i));
-      if (dir_name[i] == '\0')
-	break;
-    }
-  f->eax = dir_chdir (dir_name);
-  free (dir_name);
+  f->eax = dir_chdir ((char *) args[0]);
 }
 
-void
-handle_sys_readdir (struct intr_frame *f)
+static void
+handle_sys_readdir (struct intr_frame *f, uint32_t *args)
 {
-  uint32_t dd, buffer;
   struct dir *dir;
-  dd = *(uint32_t *) (f->esp + (sizeof (uint32_t)));
-  buffer = *(uint32_t *) (f->esp + (sizeof (uint32_t)) * 2);
-  char buf[READDIR_MAX_LEN + 1];
-  int i;
+  char buf[READDIR_MAX_LEN + 1] = "";
 
-  dir = get_dir_from_handle (dd);
+  dir = get_dir_from_handle (args[0]);
   f->eax = dir_readdir (dir, buf);
-  for (i = 0; i < READDIR_MAX_LEN && buf[i] != '\0'; i++)
-    {
-      put_user (f, (void *) buffer + i, buf[i]);      
-    }
-  put_user (f, (void *) buffer + i, '\0');
+  buf[READDIR_MAX_LEN] = '\0';
+  if (!copy_to_user ((void *) args[1], buf, strlen (buf) + 1))
+    handle_sys_exit (f, -1);
 }
 
-void
-handle_sys_isdir (struct intr_frame *f)
+static void
+handle_sys_isdir (struct intr_frame *f, uint32_t *args)
 {
   uint32_t dd;
-  dd = *(uint32_t *) (f->esp + (sizeof (uint32_t)));
+  dd = args[0];
   
   if (get_dir_from_handle (dd))
     f->eax = true;
@@ -744,11 +843,11 @@ handle_sys_isdir (struct intr_frame *f)
     f->eax = -1;
 }
 
-void
-handle_sys_inumber (struct intr_frame *f)
+static void
+handle_sys_inumber (struct intr_frame *f, uint32_t *args)
 {
   uint32_t fd;
-  fd = *(uint32_t *) (f->esp + (sizeof (uint32_t)));
+  fd = args[0];
 
   struct file *file = NULL;
   struct dir *dir = NULL;
@@ -771,70 +870,173 @@ handle_sys_inumber (struct intr_frame *f)
   f->eax = 0;
 }
 
+#ifdef VM
 static void
-syscall_handler (struct intr_frame *f) 
+handle_sys_fork (struct intr_frame *f, uint32_t *args UNUSED)
+{
+  f->eax = process_fork (f);
+}
+
+static void
+handle_sys_mmap (struct intr_frame *f, uint32_t *args)
 {
-  if ((uint32_t) f->esp > (uint32_t) PHYS_BASE || ((uint32_t) f->esp) < 0x08048000)
+  uint32_t fd, addr;
+  fd = args[0];
+  addr = args[1];
+
+  struct file *file = get_file_from_handle (fd);
+  if (file == NULL)
+    f->eax = MAP_FAILED;
+  else
+    f->eax = mmap_map (file, (void *) addr);
+}
+
+static void
+handle_sys_munmap (struct intr_frame *f, uint32_t *args)
+{
+  uint32_t mapid;
+  mapid = args[0];
+
+  if (!mmap_unmap (mapid))
     handle_sys_exit (f, -1);
+}
+#endif
+
+static void
+handle_sys_halt (struct intr_frame *f UNUSED, uint32_t *args UNUSED)
+{
+  shutdown_power_off ();
+}
+
+/* Exits with the status in ARGS[0].  (handle_sys_exit() is also
+   how the kernel kills a process, so it takes the status
+   directly.) */
+static void
+sys_exit (struct intr_frame *f, uint32_t *args)
+{
+  handle_sys_exit (f, args[0]);
+}
+
+static void
+handle_sys_sched_trace (struct intr_frame *f UNUSED, uint32_t *args UNUSED)
+{
+  sched_trace_dump ();
+}
 
-  switch ( *(uint32_t *) f->esp)
+/* Fetches the CNT arguments of system call SC from the user
+   stack at ESP into ARGS and decodes them.  Returns
+   COPY_STRING_OK if successful.  Otherwise frees any strings
+   already decoded and returns COPY_STRING_TOO_LONG if a string
+   argument was readable but did not fit in a page (or no page
+   was available for it), or COPY_STRING_BAD if an argument was
+   not accessible. */
+static enum copy_string_result
+fetch_args (const struct syscall *sc, const uint32_t *esp, uint32_t *args)
+{
+  enum copy_string_result result = COPY_STRING_OK;
+  int i;
+
+  if (!copy_from_user (args, esp + 1, sc->arg_cnt * sizeof *args))
+    return COPY_STRING_BAD;
+  for (i = 0; i < sc->arg_cnt; i++)
+    if (sc->args[i] == ARG_PTR && !is_user_vaddr ((void *) args[i]))
+      {
+        result = COPY_STRING_BAD;
+        break;
+      }
+    else if (sc->args[i] == ARG_STRING)
+      {
+        char *string = palloc_get_page (0);
+        if (string == NULL)
+          result = COPY_STRING_TOO_LONG;
+        else
+          result = copy_string_from_user (string, (char *) args[i], PGSIZE);
+        if (result != COPY_STRING_OK)
+          {
+            palloc_free_page (string);
+            break;
+          }
+        args[i] = (uint32_t) string;
+      }
+  if (i == sc->arg_cnt)
+    return COPY_STRING_OK;
+
+  while (i-- > 0)
+    if (sc->args[i] == ARG_STRING)
+      palloc_free_page ((void *) args[i]);
+  return result;
+}
+
+/* Handles the system call whose frame is F, whether it entered
+   through int $0x30 or through SYSENTER.  Looks up the call in
+   syscalls[], fetches and checks all of its arguments, kills the
+   process if any is bad, fails the call if a string argument is
+   too long, and otherwise runs the handler, timing it for the
+   statistics. */
+void
+syscall_handler (struct intr_frame *f) 
+{
+  uint32_t args[SYSCALL_MAX_ARGS];
+  struct syscall *sc;
+  uint32_t nr;
+  uint64_t start, cycles;
+  unsigned bucket;
+  int i;
+
+#ifdef VM
+  thread_current ()->user_esp = f->esp;
+#endif
+
+  if (!copy_from_user (&nr, f->esp, sizeof nr)
+      || nr >= SYSCALL_CNT || syscalls[nr].handler == NULL)
+    handle_sys_exit (f, -1);
+  sc = &syscalls[nr];
+  switch (fetch_args (sc, f->esp, args))
     {
-    case SYS_HALT : 
-      shutdown_power_off ();
-      break;
-    case SYS_EXIT : 
-      handle_sys_exit (f, (int) NULL);
-      break;
-    case SYS_EXEC :
-      handle_sys_exec (f);
-      break;
-    case SYS_WAIT :
-      handle_sys_wait (f);
-      break;
-    case SYS_FILESIZE :
-      handle_sys_filesize (f);
-      break;
-    case SYS_READ :
-      handle_sys_read (f);
-      break;
-    case SYS_WRITE : 
-      handle_sys_write (f);
-      break;
-    case SYS_CREATE :
-      handle_sys_create (f);
-      break;
-    case SYS_OPEN :
-      handle_sys_open (f);
-      break;
-    case SYS_CLOSE :
-      handle_sys_close (f);
+    case COPY_STRING_OK:
       break;
-    case SYS_REMOVE :
-      handle_sys_remove (f);
-      break;
-    case SYS_SEEK :
-      handle_sys_seek (f);
-      break;
-    case SYS_TELL :
-      handle_sys_tell (f);
-      break;
-    case SYS_MKDIR :
-      handle_sys_mkdir (f);
-      break;
-    case SYS_CHDIR :
-      handle_sys_chdir (f);
-      break;
-    case SYS_READDIR :
-      handle_sys_readdir (f);
-      break;
-    case SYS_ISDIR :
-      handle_sys_isdir (f);
-      break;
-    case SYS_INUMBER :
-      handle_sys_inumber (f);
-      break;
-    default :
-      handle_sys_exit (f, -1);      
+    case COPY_STRING_TOO_LONG:
+      sc->call_cnt++;
+      f->eax = sc->too_long_result;
+      return;
+    case COPY_STRING_BAD:
+      handle_sys_exit (f, -1);
+    }
+
+  sc->call_cnt++;
+  start = rdtsc ();
+  sc->handler (f, args);
+  cycles = rdtsc () - start;
+
+  for (bucket = 0; bucket < LATENCY_BUCKETS - 1; bucket++)
+    if (cycles < (1024ULL << (2 * bucket)))
       break;
+  sc->latency[bucket]++;
+
+  for (i = 0; i < sc->arg_cnt; i++)
+    if (sc->args[i] == ARG_STRING)
+      palloc_free_page ((void *) args[i]);
+}
+
+/* Prints system call statistics: for each call made at least
+   once, the number of calls and a histogram of their latencies
+   in CPU cycles. */
+void
+syscall_print_stats (void) 
+{
+  size_t nr;
+  int i;
+
+  printf ("Syscalls:    calls   <1K   <4K  <16K  <64K <256K"
+          "   <1M   <4M  more\n");
+  for (nr = 0; nr < SYSCALL_CNT; nr++)
+    {
+      const struct syscall *sc = &syscalls[nr];
+      if (sc->call_cnt == 0)
+        continue;
+      printf ("%-11s %6llu", sc->name, sc->call_cnt);
+      for (i = 0; i < LATENCY_BUCKETS; i++)
+        printf (" %5llu", sc->latency[i]);
+      printf ("\n");
     }
 }
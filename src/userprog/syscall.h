@@ -1,6 +1,12 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 
+struct intr_frame;
+
 void syscall_init (void);
+void syscall_handler (struct intr_frame *);
+void syscall_sysenter (void);
+void syscall_print_stats (void);
+void handle_sys_exit (struct intr_frame *, int status);
 
 #endif /* userprog/syscall.h */
@@ -2,6 +2,8 @@
 #include <debug.h>
 #include <stddef.h>
 #include "userprog/gdt.h"
+#include "userprog/syscall.h"
+#include "threads/cpu.h"
 #include "threads/thread.h"
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
@@ -86,6 +88,19 @@ tss_init (void)
   tss->ss0 = SEL_KDSEG;
   tss->bitmap = 0xdfff;
   tss_update ();
+
+  /* Set up SYSENTER for fast system calls.  It enters
+     syscall_sysenter() with %esp pointing to the TSS's esp0
+     member, from which the entry stub loads the kernel stack, so
+     the MSRs never change when the scheduler switches threads.
+     SYSEXIT derives the user code and stack selectors from the
+     kernel code selector, which the GDT layout matches. */
+  if (cpuid_features () & CPUID_SEP)
+    {
+      wrmsr (MSR_SYSENTER_CS, SEL_KCSEG);
+      wrmsr (MSR_SYSENTER_ESP, (uint32_t) &tss->esp0);
+      wrmsr (MSR_SYSENTER_EIP, (uint32_t) syscall_sysenter);
+    }
 }
 
 /* Returns the kernel TSS. */
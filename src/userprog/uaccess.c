@@ -0,0 +1,163 @@
+#include "userprog/uaccess.h"
+#include <debug.h>
+#include <stdint.h>
+#include <string.h>
+#include "threads/thread.h"
+#include "userprog/pagedir.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
+
+/* Access to user memory.
+
+   A system call that reads or writes a user buffer first pins
+   the pages it covers with user_pin().  That checks that every
+   page belongs to the process and has the right access, brings
+   in any that are not resident, and keeps them resident until
+   user_unpin().  In between, the kernel may touch the buffer
+   directly: file_read() and file_write() copy straight between
+   buffer cache blocks and the pinned user pages, without a
+   kernel staging buffer, and no page fault can occur while the
+   file system holds its locks.
+
+   Without VM, every page of a process is resident from load
+   time, so pinning only checks the page directory. */
+
+static bool pin_page (const void *upage, bool write);
+static void unpin_page (const void *upage);
+
+/* Returns true if the SIZE bytes at UADDR lie entirely in user
+   address space.  Does not check that they are mapped. */
+bool
+user_range_ok (const void *uaddr, size_t size) 
+{
+  uintptr_t start = (uintptr_t) uaddr;
+
+  return (start < (uintptr_t) PHYS_BASE
+          && size <= (uintptr_t) PHYS_BASE - start);
+}
+
+/* Validates the SIZE bytes of user memory at UADDR and pins
+   them in memory, for writing if WRITE.  Returns true if
+   successful, in which case the caller must call user_unpin()
+   with the same arguments once it is done with the buffer.
+   Returns false, with nothing pinned, if any byte is not
+   accessible to the current process. */
+bool
+user_pin (const void *uaddr, size_t size, bool write) 
+{
+  const uint8_t *start = pg_round_down (uaddr);
+  const uint8_t *upage;
+
+  if (size == 0)
+    return true;
+  if (!user_range_ok (uaddr, size))
+    return false;
+
+  for (upage = start; upage < (const uint8_t *) uaddr + size;
+       upage += PGSIZE)
+    if (!pin_page (upage, write))
+      {
+        while (upage > start)
+          {
+            upage -= PGSIZE;
+            unpin_page (upage);
+          }
+        return false;
+      }
+  return true;
+}
+
+/* Unpins the SIZE bytes at UADDR pinned by user_pin(). */
+void
+user_unpin (const void *uaddr, size_t size) 
+{
+  const uint8_t *upage;
+
+  if (size == 0)
+    return;
+  for (upage = pg_round_down (uaddr);
+       upage < (const uint8_t *) uaddr + size; upage += PGSIZE)
+    unpin_page (upage);
+}
+
+/* Copies SIZE bytes from user address USRC to kernel address
+   DST.  Returns true if successful, false if USRC is not
+   readable by the current process. */
+bool
+copy_from_user (void *dst, const void *usrc, size_t size) 
+{
+  if (!user_pin (usrc, size, false))
+    return false;
+  memcpy (dst, usrc, size);
+  user_unpin (usrc, size);
+  return true;
+}
+
+/* Copies SIZE bytes from kernel address SRC to user address
+   UDST.  Returns true if successful, false if UDST is not
+   writable by the current process. */
+bool
+copy_to_user (void *udst, const void *src, size_t size) 
+{
+  if (!user_pin (udst, size, true))
+    return false;
+  memcpy (udst, src, size);
+  user_unpin (udst, size);
+  return true;
+}
+
+/* Copies the null-terminated string at user address USRC into
+   the SIZE-byte kernel buffer DST.  Returns COPY_STRING_OK if
+   successful, COPY_STRING_BAD if the string is not readable by
+   the current process, or COPY_STRING_TOO_LONG if the first SIZE
+   bytes are readable but hold no null terminator. */
+enum copy_string_result
+copy_string_from_user (char *dst, const char *usrc, size_t size) 
+{
+  size_t copied = 0;
+
+  while (copied < size)
+    {
+      const char *src = usrc + copied;
+      size_t chunk = PGSIZE - pg_ofs (src);
+      size_t i;
+
+      if (chunk > size - copied)
+        chunk = size - copied;
+      if (!user_pin (src, chunk, false))
+        return COPY_STRING_BAD;
+      for (i = 0; i < chunk; i++)
+        if ((dst[copied + i] = src[i]) == '\0')
+          break;
+      user_unpin (src, chunk);
+      if (i < chunk)
+        return COPY_STRING_OK;
+      copied += chunk;
+    }
+  return COPY_STRING_TOO_LONG;
+}
+
+/* Pins user page UPAGE, for writing if WRITE. */
+static bool
+pin_page (const void *upage, bool write) 
+{
+#ifdef VM
+  return page_pin (upage, write);
+#else
+  uint32_t *pd = thread_current ()->pagedir;
+
+  return (pd != NULL
+          && pagedir_get_page (pd, upage) != NULL
+          && (!write || pagedir_is_writable (pd, upage)));
+#endif
+}
+
+/* Unpins user page UPAGE. */
+static void
+unpin_page (const void *upage UNUSED) 
+{
+#ifdef VM
+  page_unpin (upage);
+#endif
+}
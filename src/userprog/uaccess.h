@@ -0,0 +1,30 @@
+#ifndef USERPROG_UACCESS_H
+#define USERPROG_UACCESS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "threads/vaddr.h"
+
+/* Largest piece of a user buffer that a system call should pin
+   at once.  Longer transfers go a piece at a time, so that one
+   huge buffer cannot tie up all of physical memory. */
+#define USER_PIN_MAX (16 * PGSIZE)
+
+bool user_range_ok (const void *uaddr, size_t size);
+bool user_pin (const void *uaddr, size_t size, bool write);
+void user_unpin (const void *uaddr, size_t size);
+bool copy_from_user (void *dst, const void *usrc, size_t size);
+bool copy_to_user (void *udst, const void *src, size_t size);
+
+/* Result of copy_string_from_user(). */
+enum copy_string_result
+  {
+    COPY_STRING_OK,             /* Copied, with its null terminator. */
+    COPY_STRING_BAD,            /* Not readable by the process. */
+    COPY_STRING_TOO_LONG        /* Does not fit in the buffer. */
+  };
+
+enum copy_string_result copy_string_from_user (char *dst, const char *usrc,
+                                               size_t size);
+
+#endif /* userprog/uaccess.h */
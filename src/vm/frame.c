@@ -0,0 +1,527 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/palloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+
+/* Frame table.
+
+   Every frame of the user pool that holds a user page is on
+   FRAMES, a circular list swept by a clock hand.  When the user
+   pool is exhausted, frame_alloc() evicts a page with the
+   second-chance algorithm: a frame any of whose pages was
+   accessed since the hand last passed has the accessed bits
+   cleared and is skipped; the first frame none of whose pages
+   was is the victim.
+
+   A page's lock is held while it is being brought in, evicted,
+   or torn down, so the hand skips any frame whose page locks it
+   cannot all get without blocking.  The victim is taken off
+   FRAMES before its page is written out, so the (slow) write to
+   swap, or back to a mapped file, happens without FRAME_MUTEX
+   held.
+
+   Read-only file pages are shared: SHARED_FRAMES maps an inode
+   and offset to the frame holding that page of the file, so that
+   processes running the same executable map the same text
+   frames instead of each reading a private copy.  SHARE_MUTEX
+   protects SHARED_FRAMES and the page lists of shared frames.
+
+   A writable page is shared too, copy-on-write, between a
+   process and its fork()ed child: the frame is mapped read-only
+   in both until one of them writes to it, and then
+   frame_copy_on_write() gives the writer a private copy.  Such
+   frames are shared but not in SHARED_FRAMES.
+   It is acquired with a page lock held, so the clock, which
+   needs it before it can look at a shared frame's pages, only
+   ever try-locks it. */
+
+static struct list frames;              /* All frames holding pages. */
+static struct list_elem *hand;          /* Clock hand, or list_end. */
+static struct mutex frame_mutex;        /* Protects FRAMES and HAND. */
+static struct kmem_cache *frame_cache;  /* Cache of struct frame. */
+
+static struct hash shared_frames;       /* Shared frames by inode, ofs. */
+static struct mutex share_mutex;        /* Protects SHARED_FRAMES. */
+
+/* Statistics. */
+static long long evict_cnt;             /* # of frames evicted. */
+static long long evict_clean_cnt;       /* # of pages dropped unwritten. */
+static long long share_hit_cnt;         /* # of shared frame reuses. */
+static long long cow_share_cnt;         /* # of pages shared by fork. */
+static long long cow_copy_cnt;          /* # of copy-on-write copies. */
+
+static hash_hash_func frame_hash;
+static hash_less_func frame_less;
+static struct frame *get_frame (void);
+static void free_frame (struct frame *);
+static void link_frame (struct frame *);
+static void unlink_frame (struct frame *);
+static struct frame *evict (void);
+
+/* Initializes the frame table. */
+void
+frame_init (void) 
+{
+  list_init (&frames);
+  hand = list_end (&frames);
+  mutex_init (&frame_mutex);
+  frame_cache = kmem_cache_create ("frame", sizeof (struct frame), NULL);
+  hash_init (&shared_frames, frame_hash, frame_less, NULL);
+  mutex_init (&share_mutex);
+}
+
+/* Returns a private frame for page P, evicting another page if
+   the user pool is exhausted, or a null pointer if nothing can
+   be evicted.  The caller must hold P's lock. */
+struct frame *
+frame_alloc (struct page *p) 
+{
+  struct frame *f;
+
+  ASSERT (lock_held_by_current_thread (&p->lock));
+
+  f = get_frame ();
+  if (f == NULL)
+    return NULL;
+  list_push_back (&f->pages, &p->frame_elem);
+  link_frame (f);
+  return f;
+}
+
+/* Detaches page P from frame F, and frees F if no page maps it
+   any longer.  The caller must hold P's lock and must already
+   have removed P's mapping from its page directory. */
+void
+frame_release (struct frame *f, struct page *p) 
+{
+  bool unused;
+
+  ASSERT (lock_held_by_current_thread (&p->lock));
+
+  /* A frame on the frame table must never be seen without its
+     pages, or the clock would take it as an idle victim, so take
+     it off the table first. */
+  if (f->shared)
+    {
+      mutex_acquire (&share_mutex);
+      list_remove (&p->frame_elem);
+      unused = list_empty (&f->pages);
+      if (unused)
+        {
+          if (f->inode != NULL)
+            hash_delete (&shared_frames, &f->hash_elem);
+          unlink_frame (f);
+        }
+      mutex_release (&share_mutex);
+    }
+  else
+    {
+      unlink_frame (f);
+      list_remove (&p->frame_elem);
+      unused = true;
+    }
+
+  if (unused)
+    free_frame (f);
+}
+
+/* Makes page P, which must not be on any frame and whose lock
+   the caller must hold, share frame F copy-on-write with the
+   page or pages already mapping it.  The caller is responsible
+   for mapping every such page read-only. */
+void
+frame_share_cow (struct frame *f, struct page *p) 
+{
+  ASSERT (lock_held_by_current_thread (&p->lock));
+
+  mutex_acquire (&share_mutex);
+  f->shared = true;
+  list_push_back (&f->pages, &p->frame_elem);
+  mutex_release (&share_mutex);
+  cow_share_cnt++;
+}
+
+/* Gives page P, whose lock the caller must hold, a private copy
+   of the frame it shares copy-on-write, and returns that frame.
+   If no other page shares P's frame any longer, returns P's
+   frame as is.  Returns a null pointer if no frame can be
+   allocated for the copy. */
+struct frame *
+frame_copy_on_write (struct page *p) 
+{
+  struct frame *old = p->frame;
+  struct frame *new;
+  bool unused;
+
+  ASSERT (lock_held_by_current_thread (&p->lock));
+
+  if (!old->shared)
+    return old;
+  mutex_acquire (&share_mutex);
+  if (list_size (&old->pages) == 1)
+    {
+      old->shared = false;
+      mutex_release (&share_mutex);
+      return old;
+    }
+  mutex_release (&share_mutex);
+
+  /* OLD cannot be evicted while locked P is one of its pages, so
+     it is safe to copy from it until P is taken off it. */
+  new = get_frame ();
+  if (new == NULL)
+    return NULL;
+  memcpy (new->kpage, old->kpage, PGSIZE);
+  cow_copy_cnt++;
+
+  /* The other pages may have let go of OLD meanwhile. */
+  mutex_acquire (&share_mutex);
+  list_remove (&p->frame_elem);
+  unused = list_empty (&old->pages);
+  if (unused)
+    unlink_frame (old);
+  mutex_release (&share_mutex);
+  if (unused)
+    free_frame (old);
+
+  list_push_back (&new->pages, &p->frame_elem);
+  link_frame (new);
+  return new;
+}
+
+/* Looks for the shared frame holding the READ_BYTES bytes at
+   offset OFS in INODE.  If there is one, attaches page P, whose
+   lock the caller must hold, and returns the frame; otherwise,
+   returns a null pointer. */
+struct frame *
+frame_share_get (struct inode *inode, off_t ofs, size_t read_bytes,
+                 struct page *p) 
+{
+  struct frame key;
+  struct hash_elem *e;
+  struct frame *f = NULL;
+
+  ASSERT (lock_held_by_current_thread (&p->lock));
+
+  key.inode = inode;
+  key.ofs = ofs;
+  key.read_bytes = read_bytes;
+
+  mutex_acquire (&share_mutex);
+  e = hash_find (&shared_frames, &key.hash_elem);
+  if (e != NULL)
+    {
+      f = hash_entry (e, struct frame, hash_elem);
+      list_push_back (&f->pages, &p->frame_elem);
+      share_hit_cnt++;
+    }
+  mutex_release (&share_mutex);
+  return f;
+}
+
+/* Makes private frame F, which holds the READ_BYTES bytes at
+   offset OFS in INODE, available to frame_share_get().  If
+   another process has published the same page meanwhile, moves
+   F's page to that frame, frees F, and returns the other frame;
+   otherwise returns F. */
+struct frame *
+frame_share_put (struct frame *f, struct inode *inode, off_t ofs,
+                 size_t read_bytes) 
+{
+  struct hash_elem *e;
+  struct frame *other;
+  struct page *p;
+
+  ASSERT (!f->shared && list_size (&f->pages) == 1);
+
+  p = list_entry (list_front (&f->pages), struct page, frame_elem);
+  f->inode = inode;
+  f->ofs = ofs;
+  f->read_bytes = read_bytes;
+
+  mutex_acquire (&share_mutex);
+  e = hash_insert (&shared_frames, &f->hash_elem);
+  if (e == NULL)
+    {
+      f->shared = true;
+      mutex_release (&share_mutex);
+      return f;
+    }
+  other = hash_entry (e, struct frame, hash_elem);
+  unlink_frame (f);
+  list_remove (&p->frame_elem);
+  list_push_back (&other->pages, &p->frame_elem);
+  share_hit_cnt++;
+  mutex_release (&share_mutex);
+
+  free_frame (f);
+  return other;
+}
+
+/* Prints frame table statistics. */
+void
+frame_print_stats (void) 
+{
+  printf ("Frame: %lld evictions, %lld clean, %lld shared hits\n",
+          evict_cnt, evict_clean_cnt, share_hit_cnt);
+  printf ("Frame: %lld copy-on-write shares, %lld copies\n",
+          cow_share_cnt, cow_copy_cnt);
+}
+
+/* Returns a new private frame mapped by no page and not yet on
+   the frame table, evicting a page if the user pool is
+   exhausted, or a null pointer if nothing can be evicted. */
+static struct frame *
+get_frame (void) 
+{
+  struct frame *f;
+  void *kpage;
+
+  kpage = palloc_get_page (PAL_USER);
+  if (kpage != NULL)
+    {
+      f = kmem_cache_alloc (frame_cache);
+      if (f == NULL)
+        {
+          palloc_free_page (kpage);
+          return NULL;
+        }
+      f->kpage = kpage;
+      list_init (&f->pages);
+    }
+  else
+    {
+      f = evict ();
+      if (f == NULL)
+        return NULL;
+    }
+  f->shared = false;
+  f->inode = NULL;
+  return f;
+}
+
+/* Frees F, which must be mapped by no page and be off the frame
+   table. */
+static void
+free_frame (struct frame *f) 
+{
+  palloc_free_page (f->kpage);
+  kmem_cache_free (frame_cache, f);
+}
+
+/* Adds F, which must have at least one page, to the frame
+   table. */
+static void
+link_frame (struct frame *f) 
+{
+  ASSERT (!list_empty (&f->pages));
+
+  mutex_acquire (&frame_mutex);
+  list_push_back (&frames, &f->elem);
+  mutex_release (&frame_mutex);
+}
+
+/* Removes F from the frame table. */
+static void
+unlink_frame (struct frame *f) 
+{
+  mutex_acquire (&frame_mutex);
+  if (hand == &f->elem)
+    hand = list_next (hand);
+  list_remove (&f->elem);
+  mutex_release (&frame_mutex);
+}
+
+/* Advances the clock hand, wrapping around at the end of
+   FRAMES, and returns the frame it passed over. */
+static struct frame *
+advance_hand (void) 
+{
+  struct frame *f;
+
+  if (hand == list_end (&frames))
+    hand = list_begin (&frames);
+  f = list_entry (hand, struct frame, elem);
+  hand = list_next (hand);
+  return f;
+}
+
+/* Tries to acquire the lock of every page mapping F without
+   blocking.  Returns true if successful; otherwise, releases
+   any it acquired and returns false. */
+static bool
+try_lock_pages (struct frame *f) 
+{
+  struct list_elem *e, *e2;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+      if (lock_held_by_current_thread (&p->lock)
+          || !lock_try_acquire (&p->lock))
+        {
+          for (e2 = list_begin (&f->pages); e2 != e; e2 = list_next (e2))
+            lock_release (&list_entry (e2, struct page, frame_elem)->lock);
+          return false;
+        }
+    }
+  return true;
+}
+
+/* Releases the locks of the pages mapping F. */
+static void
+unlock_pages (struct frame *f) 
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    lock_release (&list_entry (e, struct page, frame_elem)->lock);
+}
+
+/* Returns true if any page mapping F was accessed since the
+   last call, clearing the accessed bits. */
+static bool
+test_and_clear_accessed (struct frame *f) 
+{
+  struct list_elem *e;
+  bool accessed = false;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+      uint32_t *pd = p->owner->pagedir;
+      if (pagedir_is_accessed (pd, p->upage))
+        {
+          pagedir_set_accessed (pd, p->upage, false);
+          accessed = true;
+        }
+    }
+  return accessed;
+}
+
+/* Chooses a victim frame with the clock algorithm, writes its
+   page to swap if needed, and returns the frame, now off the
+   frame table and mapped by no page.  Returns a null pointer if
+   every frame is busy. */
+static struct frame *
+evict (void) 
+{
+  struct frame *f = NULL;
+  bool share_held = false;
+  size_t i, limit;
+
+  mutex_acquire (&frame_mutex);
+
+  /* Two passes clear every accessed bit, so a third must find
+     a victim unless all the pages are locked. */
+  limit = 3 * list_size (&frames);
+  for (i = 0; i < limit; i++)
+    {
+      f = advance_hand ();
+      if (f->shared)
+        {
+          if (mutex_held_by_current_thread (&share_mutex)
+              || !mutex_try_acquire (&share_mutex))
+            continue;
+          share_held = true;
+        }
+      if (try_lock_pages (f))
+        {
+          if (!test_and_clear_accessed (f))
+            break;
+          unlock_pages (f);
+        }
+      if (share_held)
+        {
+          mutex_release (&share_mutex);
+          share_held = false;
+        }
+    }
+  if (i == limit)
+    {
+      mutex_release (&frame_mutex);
+      return NULL;
+    }
+  if (hand == &f->elem)
+    hand = list_next (hand);
+  list_remove (&f->elem);
+  mutex_release (&frame_mutex);
+
+  /* With every page locked and the frame out of the shared frame
+     table, no one else can map it. */
+  if (share_held)
+    {
+      if (f->inode != NULL)
+        hash_delete (&shared_frames, &f->hash_elem);
+      mutex_release (&share_mutex);
+    }
+
+  while (!list_empty (&f->pages))
+    {
+      struct page *p = list_entry (list_pop_front (&f->pages),
+                                   struct page, frame_elem);
+      uint32_t *pd = p->owner->pagedir;
+
+      /* Unmap the page before checking the dirty bit, so that
+         the owner cannot dirty it after we look. */
+      pagedir_clear_page (pd, p->upage);
+      if (p->type == PAGE_MMAP)
+        {
+          if (pagedir_is_dirty (pd, p->upage))
+            file_write_at (p->file, f->kpage, p->read_bytes, p->ofs);
+          else
+            evict_clean_cnt++;
+        }
+      else if (p->type == PAGE_SWAP || pagedir_is_dirty (pd, p->upage))
+        {
+          /* Each page sharing a frame copy-on-write gets its own
+             copy in swap. */
+          p->swap_slot = swap_out (f->kpage);
+          if (p->swap_slot == SWAP_ERROR)
+            PANIC ("out of swap space");
+          p->type = PAGE_SWAP;
+        }
+      else
+        evict_clean_cnt++;
+      p->frame = NULL;
+      lock_release (&p->lock);
+    }
+  evict_cnt++;
+  return f;
+}
+
+/* Returns a hash value for shared frame F. */
+static unsigned
+frame_hash (const struct hash_elem *f_, void *aux UNUSED) 
+{
+  const struct frame *f = hash_entry (f_, struct frame, hash_elem);
+  return hash_bytes (&f->inode, sizeof f->inode) ^ hash_int (f->ofs);
+}
+
+/* Returns true if shared frame A precedes shared frame B. */
+static bool
+frame_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED) 
+{
+  const struct frame *a = hash_entry (a_, struct frame, hash_elem);
+  const struct frame *b = hash_entry (b_, struct frame, hash_elem);
+
+  if (a->inode != b->inode)
+    return a->inode < b->inode;
+  else if (a->ofs != b->ofs)
+    return a->ofs < b->ofs;
+  else
+    return a->read_bytes < b->read_bytes;
+}
@@ -0,0 +1,45 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include "filesys/off_t.h"
+
+struct inode;
+struct page;
+
+/* A physical frame from the user pool holding a user page.
+
+   A private frame is mapped by exactly one page.  A shared frame
+   may be mapped by a page in each of several processes and is
+   freed when its last page lets go of it.  It holds either a
+   read-only page of a file, found by the file's inode and the
+   page's offset in it, or a writable page shared copy-on-write
+   after fork(). */
+struct frame
+  {
+    void *kpage;                /* Kernel virtual address of frame. */
+    struct list pages;          /* struct page's mapping the frame. */
+    struct list_elem elem;      /* Element in frame table. */
+
+    /* For shared frames. */
+    bool shared;                /* May PAGES have more than one page? */
+    struct inode *inode;        /* File page was read from, if any. */
+    off_t ofs;                  /* Offset of the page in INODE. */
+    size_t read_bytes;          /* Bytes read from INODE. */
+    struct hash_elem hash_elem; /* Element in shared frame table. */
+  };
+
+void frame_init (void);
+struct frame *frame_alloc (struct page *);
+void frame_release (struct frame *, struct page *);
+void frame_share_cow (struct frame *, struct page *);
+struct frame *frame_copy_on_write (struct page *);
+struct frame *frame_share_get (struct inode *, off_t ofs, size_t read_bytes,
+                               struct page *);
+struct frame *frame_share_put (struct frame *, struct inode *, off_t ofs,
+                               size_t read_bytes);
+void frame_print_stats (void);
+
+#endif /* vm/frame.h */
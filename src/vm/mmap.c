@@ -0,0 +1,143 @@
+#include "vm/mmap.h"
+#include <list.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/page.h"
+
+/* Memory-mapped files.
+
+   A mapping registers one PAGE_MMAP page per page of the file in
+   the supplemental page table and reads nothing until the
+   process touches a page.  Pages are read and written back with
+   file_read_at() and file_write_at(), so they go through the
+   buffer cache like any other file I/O.  The mapping keeps its
+   own reopened file, so closing or removing the file does not
+   affect it. */
+
+/* One mapping. */
+struct mapping
+  {
+    int mapid;                  /* Mapping identifier. */
+    struct file *file;          /* Mapped file. */
+    uint8_t *base;              /* Start of mapping. */
+    size_t page_cnt;            /* Number of pages mapped. */
+    struct list_elem elem;      /* Element in thread's mappings. */
+  };
+
+static struct mapping *find_mapping (int mapid);
+static void unmap (struct mapping *);
+
+/* Initializes the current process's list of mappings. */
+void
+mmap_table_init (void) 
+{
+  struct thread *t = thread_current ();
+
+  list_init (&t->mappings);
+  t->next_mapid = 0;
+}
+
+/* Maps FILE into the current process at ADDR.  Returns the new
+   mapping's identifier, or -1 if FILE is empty, ADDR is null or
+   not page-aligned, or the mapping would overlap any page
+   already in use. */
+int
+mmap_map (struct file *file, void *addr) 
+{
+  struct thread *t = thread_current ();
+  struct mapping *m;
+  off_t length;
+  size_t i;
+
+  length = file_length (file);
+  if (addr == NULL || pg_ofs (addr) != 0 || length == 0)
+    return -1;
+  for (i = 0; i < (size_t) length; i += PGSIZE)
+    if (!is_user_vaddr ((uint8_t *) addr + i)
+        || page_lookup ((uint8_t *) addr + i) != NULL)
+      return -1;
+
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    return -1;
+  m->file = file_reopen (file);
+  if (m->file == NULL)
+    {
+      free (m);
+      return -1;
+    }
+  m->base = addr;
+  m->page_cnt = 0;
+  m->mapid = t->next_mapid++;
+  list_push_back (&t->mappings, &m->elem);
+
+  while (length > 0)
+    {
+      size_t page_read_bytes = length < PGSIZE ? length : PGSIZE;
+      if (!page_add_mmap (m->base + m->page_cnt * PGSIZE, m->file,
+                          m->page_cnt * PGSIZE, page_read_bytes))
+        {
+          unmap (m);
+          return -1;
+        }
+      m->page_cnt++;
+      length -= page_read_bytes;
+    }
+  return m->mapid;
+}
+
+/* Unmaps the current process's mapping MAPID, writing back any
+   modified pages.  Returns false if there is no such mapping. */
+bool
+mmap_unmap (int mapid) 
+{
+  struct mapping *m = find_mapping (mapid);
+
+  if (m == NULL)
+    return false;
+  unmap (m);
+  return true;
+}
+
+/* Unmaps all of the current process's mappings. */
+void
+mmap_unmap_all (void) 
+{
+  struct list *mappings = &thread_current ()->mappings;
+
+  while (!list_empty (mappings))
+    unmap (list_entry (list_front (mappings), struct mapping, elem));
+}
+
+/* Returns the current process's mapping MAPID, or a null
+   pointer if there is none. */
+static struct mapping *
+find_mapping (int mapid) 
+{
+  struct list *mappings = &thread_current ()->mappings;
+  struct list_elem *e;
+
+  for (e = list_begin (mappings); e != list_end (mappings);
+       e = list_next (e))
+    {
+      struct mapping *m = list_entry (e, struct mapping, elem);
+      if (m->mapid == mapid)
+        return m;
+    }
+  return NULL;
+}
+
+/* Removes M's pages, writing back modified ones, and frees M. */
+static void
+unmap (struct mapping *m) 
+{
+  size_t i;
+
+  for (i = 0; i < m->page_cnt; i++)
+    page_remove (m->base + i * PGSIZE);
+  list_remove (&m->elem);
+  file_close (m->file);
+  free (m);
+}
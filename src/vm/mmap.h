@@ -0,0 +1,13 @@
+#ifndef VM_MMAP_H
+#define VM_MMAP_H
+
+#include <stdbool.h>
+
+struct file;
+
+void mmap_table_init (void);
+int mmap_map (struct file *, void *addr);
+bool mmap_unmap (int mapid);
+void mmap_unmap_all (void);
+
+#endif /* vm/mmap.h */
@@ -0,0 +1,515 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/palloc.h"
+#include "threads/slab.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/swap.h"
+
+/* Supplemental page table.
+
+   Each process has a hash table of struct page, keyed by user
+   page address, describing every page of its address space that
+   it may touch.  Executable segments are registered here when
+   the process is loaded, but nothing is read until the process
+   first touches a page: then the page fault handler calls
+   page_fault_in(), which allocates a frame, fills it from the
+   page's source, and maps it.  A process therefore pays only for
+   the pages it actually uses.
+
+   A page may later be evicted to make room for another (see
+   vm/frame.c).  A clean file page is simply dropped and read
+   again on the next fault; any other page that has been written
+   becomes a PAGE_SWAP page and is read back from swap, except
+   that a page of a memory-mapped file is written back to the
+   file.  Pages of
+   read-only segments are never written, so their frames are
+   shared by every process running the same executable. */
+
+/* Maximum size of a process's stack, in bytes.  The stack grows
+   a page at a time on demand, but never below PHYS_BASE minus
+   this. */
+size_t page_stack_max = STACK_MAX_DEFAULT;
+
+/* Cache of struct page objects. */
+static struct kmem_cache *page_cache;
+
+static hash_hash_func page_hash;
+static hash_less_func page_less;
+static hash_action_func page_destroy;
+static struct page *page_add (void *upage, enum page_type, bool writable);
+
+/* Initializes the supplemental page table module. */
+void
+page_init (void) 
+{
+  page_cache = kmem_cache_create ("page", sizeof (struct page), NULL);
+}
+
+/* Initializes PAGES as an empty supplemental page table. */
+void
+page_table_init (struct hash *pages) 
+{
+  hash_init (pages, page_hash, page_less, NULL);
+}
+
+/* Frees every entry in PAGES, along with its frame or swap
+   slot, and then PAGES itself.  Must be called before the
+   process's page directory is destroyed. */
+void
+page_table_destroy (struct hash *pages) 
+{
+  hash_destroy (pages, page_destroy);
+}
+
+/* Registers UPAGE in the current process as a page whose first
+   READ_BYTES bytes are read from FILE at offset OFS and whose
+   remaining bytes are zero.  Returns true if successful, false
+   if UPAGE is already registered or memory is exhausted. */
+bool
+page_add_file (void *upage, struct file *file, off_t ofs,
+               size_t read_bytes, bool writable) 
+{
+  struct page *p;
+
+  ASSERT (read_bytes <= PGSIZE);
+
+  if (read_bytes == 0)
+    return page_add_zero (upage, writable);
+
+  p = page_add (upage, PAGE_FILE, writable);
+  if (p == NULL)
+    return false;
+  p->file = file;
+  p->ofs = ofs;
+  p->read_bytes = read_bytes;
+  return true;
+}
+
+/* Registers UPAGE in the current process as a writable page of
+   a memory-mapped file, whose first READ_BYTES bytes are those
+   at offset OFS in FILE.  Unlike other file pages, the page is
+   written back to FILE, not to swap, when it is evicted or
+   unmapped after being modified.  Returns true if successful,
+   false if UPAGE is already registered or memory is exhausted. */
+bool
+page_add_mmap (void *upage, struct file *file, off_t ofs,
+               size_t read_bytes) 
+{
+  struct page *p;
+
+  ASSERT (read_bytes > 0 && read_bytes <= PGSIZE);
+
+  p = page_add (upage, PAGE_MMAP, true);
+  if (p == NULL)
+    return false;
+  p->file = file;
+  p->ofs = ofs;
+  p->read_bytes = read_bytes;
+  return true;
+}
+
+/* Registers UPAGE in the current process as a page of zeros.
+   Returns true if successful, false if UPAGE is already
+   registered or memory is exhausted. */
+bool
+page_add_zero (void *upage, bool writable) 
+{
+  return page_add (upage, PAGE_ZERO, writable) != NULL;
+}
+
+/* Removes UPAGE from the current process's page table, writing
+   it back first if it is a modified page of a mapped file. */
+void
+page_remove (void *upage) 
+{
+  struct page *p = page_lookup (upage);
+
+  if (p != NULL)
+    {
+      hash_delete (&thread_current ()->pages, &p->hash_elem);
+      page_destroy (&p->hash_elem, NULL);
+    }
+}
+
+/* Returns the current process's page table entry for the page
+   containing UPAGE, or a null pointer if there is none. */
+struct page *
+page_lookup (const void *upage) 
+{
+  struct page p;
+  struct hash_elem *e;
+
+  p.upage = pg_round_down (upage);
+  e = hash_find (&thread_current ()->pages, &p.hash_elem);
+  return e != NULL ? hash_entry (e, struct page, hash_elem) : NULL;
+}
+
+/* Brings the page containing FAULT_ADDR into memory and maps it
+   in the current process's page directory.  Returns true if
+   successful, false if FAULT_ADDR is not part of the process's
+   address space or memory is exhausted. */
+bool
+page_fault_in (const void *fault_addr) 
+{
+  struct thread *t = thread_current ();
+  struct page *p;
+  struct frame *f;
+  struct inode *inode = NULL;
+  uint8_t *kpage;
+  bool shared;
+  bool success = false;
+
+  if (!is_user_vaddr (fault_addr) || t->pagedir == NULL)
+    return false;
+  p = page_lookup (fault_addr);
+  if (p == NULL)
+    return false;
+
+  /* If another thread loaded the page while we waited for its
+     lock, there is nothing left to do. */
+  lock_acquire (&p->lock);
+  if (p->frame != NULL)
+    {
+      success = true;
+      goto done;
+    }
+
+  /* Read-only file pages are shared among processes running the
+     same executable. */
+  shared = p->type == PAGE_FILE && !p->writable;
+  if (shared)
+    {
+      inode = file_get_inode (p->file);
+      f = frame_share_get (inode, p->ofs, p->read_bytes, p);
+      if (f != NULL)
+        goto map;
+    }
+
+  f = frame_alloc (p);
+  if (f == NULL)
+    goto done;
+  kpage = f->kpage;
+
+  if (p->type == PAGE_FILE || p->type == PAGE_MMAP)
+    {
+      if (file_read_at (p->file, kpage, p->read_bytes, p->ofs)
+          != (off_t) p->read_bytes)
+        {
+          frame_release (f, p);
+          goto done;
+        }
+      memset (kpage + p->read_bytes, 0, PGSIZE - p->read_bytes);
+    }
+  else if (p->type == PAGE_SWAP)
+    {
+      swap_in (p->swap_slot, kpage);
+      p->swap_slot = SWAP_ERROR;
+    }
+  else
+    memset (kpage, 0, PGSIZE);
+  if (shared)
+    f = frame_share_put (f, inode, p->ofs, p->read_bytes);
+
+ map:
+  if (!pagedir_set_page (t->pagedir, p->upage, f->kpage, p->writable))
+    {
+      frame_release (f, p);
+      goto done;
+    }
+  p->frame = f;
+  success = true;
+
+ done:
+  lock_release (&p->lock);
+  return success;
+}
+
+/* Copies the supplemental page table PARENT_PAGES of a process
+   that is blocked in fork() into the current process, which
+   must have an empty page table and page directory.  Resident
+   writable pages end up sharing their frames copy-on-write,
+   read-only in both processes; pages in swap are copied to new
+   slots; the rest are described by the same source, except that
+   executable pages are read from EXE, the child's own handle on
+   the executable.  Pages of memory-mapped files are not copied.
+   Returns true if successful, false if memory or swap is
+   exhausted. */
+bool
+page_table_copy (struct hash *parent_pages, struct file *exe) 
+{
+  uint32_t *pd = thread_current ()->pagedir;
+  struct hash_iterator i;
+
+  hash_first (&i, parent_pages);
+  while (hash_next (&i))
+    {
+      struct page *pp = hash_entry (hash_cur (&i), struct page, hash_elem);
+      struct page *c;
+      bool ok = true;
+
+      if (pp->type == PAGE_MMAP)
+        continue;
+      c = page_add (pp->upage, pp->type, pp->writable);
+      if (c == NULL)
+        return false;
+      c->file = pp->type == PAGE_FILE ? exe : NULL;
+      c->ofs = pp->ofs;
+      c->read_bytes = pp->read_bytes;
+
+      lock_acquire (&pp->lock);
+      lock_acquire (&c->lock);
+      if (pp->frame != NULL)
+        {
+          if (pp->writable)
+            {
+              /* A modified page can no longer be recovered from
+                 its source, so both copies must go to swap if
+                 they are evicted. */
+              uint32_t *ppd = pp->owner->pagedir;
+              if (pagedir_is_dirty (ppd, pp->upage))
+                pp->type = PAGE_SWAP;
+              c->type = pp->type;
+              pagedir_set_writable (ppd, pp->upage, false);
+            }
+          frame_share_cow (pp->frame, c);
+          c->frame = pp->frame;
+          if (!pagedir_set_page (pd, c->upage, c->frame->kpage, false))
+            {
+              frame_release (c->frame, c);
+              c->frame = NULL;
+              ok = false;
+            }
+        }
+      else if (pp->type == PAGE_SWAP)
+        {
+          c->swap_slot = swap_dup (pp->swap_slot);
+          ok = c->swap_slot != SWAP_ERROR;
+        }
+      lock_release (&c->lock);
+      lock_release (&pp->lock);
+      if (!ok)
+        return false;
+    }
+  return true;
+}
+
+/* Handles a write to the page containing FAULT_ADDR that the
+   current process may write but that is mapped read-only because
+   it shares its frame copy-on-write.  Gives the process its own
+   copy of the frame, if another process still shares it, and
+   maps it writable.  Returns true if successful, false if
+   FAULT_ADDR is not a writable page or memory is exhausted. */
+bool
+page_copy_on_write (const void *fault_addr) 
+{
+  uint32_t *pd = thread_current ()->pagedir;
+  struct page *p;
+  struct frame *f;
+  bool success = true;
+
+  if (!is_user_vaddr (fault_addr) || pd == NULL)
+    return false;
+  p = page_lookup (fault_addr);
+  if (p == NULL || !p->writable)
+    return false;
+
+  lock_acquire (&p->lock);
+  if (p->frame == NULL)
+    {
+      /* Evicted meanwhile, and so no longer shared. */
+      lock_release (&p->lock);
+      return page_fault_in (fault_addr);
+    }
+  f = frame_copy_on_write (p);
+  if (f == NULL)
+    success = false;
+  else if (f == p->frame)
+    pagedir_set_writable (pd, p->upage, true);
+  else
+    {
+      pagedir_clear_page (pd, p->upage);
+      success = pagedir_set_page (pd, p->upage, f->kpage, true);
+      if (!success)
+        {
+          frame_release (f, p);
+          f = NULL;
+        }
+      p->frame = f;
+    }
+  lock_release (&p->lock);
+  return success;
+}
+
+/* Brings the page containing UADDR into the current process's
+   memory, if necessary, and pins it there by holding its lock,
+   so that the kernel can access it without faulting and the
+   clock cannot evict it until page_unpin().  A page just below
+   the stack is added as stack growth would add it.  If WRITE,
+   the page must be writable, and a page shared copy-on-write
+   first gets its own frame, since the write fault that would
+   otherwise copy it needs the lock held here.  Returns true if
+   successful, false if UADDR is not an accessible page or memory
+   is exhausted.
+
+   Pinned frames cannot be reclaimed, so the caller should pin
+   only a bounded number of pages at once, and it must unpin
+   them all before the process exits.  A page may be pinned more
+   than once, in the same direction or for reading after writing;
+   each pin needs its own page_unpin(). */
+bool
+page_pin (const void *uaddr, bool write)
+{
+  struct thread *t = thread_current ();
+  struct page *p;
+
+  if (!is_user_vaddr (uaddr) || t->pagedir == NULL)
+    return false;
+  p = page_lookup (uaddr);
+  if (p == NULL)
+    {
+      if (!page_grow_stack (uaddr, t->user_esp))
+        return false;
+      p = page_lookup (uaddr);
+    }
+  if (write && !p->writable)
+    return false;
+
+  /* Already pinned by the caller: just count the pin. */
+  if (lock_held_by_current_thread (&p->lock))
+    {
+      if (write && !pagedir_is_writable (t->pagedir, p->upage))
+        return false;
+      p->pin_cnt++;
+      return true;
+    }
+
+  for (;;)
+    {
+      lock_acquire (&p->lock);
+      if (p->frame != NULL
+          && (!write || pagedir_is_writable (t->pagedir, p->upage)))
+        return true;
+      lock_release (&p->lock);
+
+      if (p->frame == NULL
+          ? !page_fault_in (uaddr)
+          : !page_copy_on_write (uaddr))
+        return false;
+    }
+}
+
+/* Unpins the page containing UADDR, which page_pin() pinned. */
+void
+page_unpin (const void *uaddr)
+{
+  struct page *p = page_lookup (uaddr);
+
+  ASSERT (p != NULL);
+  if (p->pin_cnt > 0)
+    p->pin_cnt--;
+  else
+    lock_release (&p->lock);
+}
+
+/* Extends the current process's stack to cover FAULT_ADDR, if
+   FAULT_ADDR looks like a stack access given user stack pointer
+   ESP, and brings in the new page.  The new page is a lazy zero
+   page; pages between it and the rest of the stack are added
+   only if they are touched in turn.  Returns true if
+   successful.
+
+   An access counts as a stack access if it is no more than 32
+   bytes below ESP, since PUSHA checks permissions on all 32
+   bytes it writes before it decrements ESP, and within
+   page_stack_max bytes of PHYS_BASE. */
+bool
+page_grow_stack (const void *fault_addr, const void *esp) 
+{
+  uint8_t *upage = pg_round_down (fault_addr);
+
+  if (!is_user_vaddr (fault_addr)
+      || (uint8_t *) fault_addr < (uint8_t *) esp - 32
+      || upage < (uint8_t *) PHYS_BASE - page_stack_max)
+    return false;
+  return page_add_zero (upage, true) && page_fault_in (upage);
+}
+
+/* Adds an entry of TYPE for UPAGE to the current process's page
+   table and returns it, or returns a null pointer if UPAGE is
+   already present or memory is exhausted. */
+static struct page *
+page_add (void *upage, enum page_type type, bool writable) 
+{
+  struct page *p;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (upage));
+
+  p = kmem_cache_alloc (page_cache);
+  if (p == NULL)
+    return NULL;
+  p->upage = upage;
+  p->owner = thread_current ();
+  p->type = type;
+  p->writable = writable;
+  lock_init (&p->lock);
+  p->pin_cnt = 0;
+  p->frame = NULL;
+  p->file = NULL;
+  p->ofs = 0;
+  p->read_bytes = 0;
+  p->swap_slot = SWAP_ERROR;
+  if (hash_insert (&thread_current ()->pages, &p->hash_elem) != NULL)
+    {
+      kmem_cache_free (page_cache, p);
+      return NULL;
+    }
+  return p;
+}
+
+/* Returns a hash value for page P. */
+static unsigned
+page_hash (const struct hash_elem *p_, void *aux UNUSED) 
+{
+  const struct page *p = hash_entry (p_, struct page, hash_elem);
+  return hash_bytes (&p->upage, sizeof p->upage);
+}
+
+/* Returns true if page A precedes page B. */
+static bool
+page_less (const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED) 
+{
+  const struct page *a = hash_entry (a_, struct page, hash_elem);
+  const struct page *b = hash_entry (b_, struct page, hash_elem);
+
+  return a->upage < b->upage;
+}
+
+/* Frees page table entry P and its frame or swap slot, writing
+   back a modified mapped file page.  Waits for any eviction of P
+   in progress to finish first. */
+static void
+page_destroy (struct hash_elem *p_, void *aux UNUSED) 
+{
+  struct page *p = hash_entry (p_, struct page, hash_elem);
+  uint32_t *pd = thread_current ()->pagedir;
+
+  lock_acquire (&p->lock);
+  if (p->frame != NULL)
+    {
+      pagedir_clear_page (pd, p->upage);
+      if (p->type == PAGE_MMAP && pagedir_is_dirty (pd, p->upage))
+        file_write_at (p->file, p->frame->kpage, p->read_bytes, p->ofs);
+      frame_release (p->frame, p);
+    }
+  else if (p->swap_slot != SWAP_ERROR)
+    swap_free (p->swap_slot);
+  lock_release (&p->lock);
+  kmem_cache_free (page_cache, p);
+}
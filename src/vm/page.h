@@ -0,0 +1,72 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include "threads/synch.h"
+
+struct file;
+struct frame;
+
+/* Where the contents of a page that is not in memory come
+   from. */
+enum page_type
+  {
+    PAGE_FILE,                  /* Read from a file, rest zeroed. */
+    PAGE_MMAP,                  /* Mapped file: written back, not swapped. */
+    PAGE_ZERO,                  /* All zeros. */
+    PAGE_SWAP                   /* Dirtied and evicted: in swap. */
+  };
+
+/* Supplemental page table entry: describes one page of a
+   process's virtual address space, whether or not it is
+   currently mapped in the process's page directory. */
+struct page
+  {
+    void *upage;                /* User virtual address of page. */
+    enum page_type type;        /* Source of contents. */
+    bool writable;              /* May the process write the page? */
+    struct thread *owner;       /* Process whose page it is. */
+    struct lock lock;           /* Held while loading, evicting, or pinned. */
+    unsigned pin_cnt;           /* Nested pins beyond the first. */
+    struct frame *frame;        /* Frame holding page, if loaded. */
+    struct list_elem frame_elem; /* Element in frame's page list. */
+
+    /* For PAGE_FILE and PAGE_MMAP. */
+    struct file *file;          /* File to read from. */
+    off_t ofs;                  /* Offset in FILE. */
+    size_t read_bytes;          /* Bytes to read; the rest are zeroed. */
+
+    /* For PAGE_SWAP. */
+    size_t swap_slot;           /* Slot holding page, if not loaded. */
+
+    struct hash_elem hash_elem; /* Element in thread's page table. */
+  };
+
+/* Default limit on the size of a process's stack, in bytes. */
+#define STACK_MAX_DEFAULT (8 * 1024 * 1024)
+
+extern size_t page_stack_max;
+
+void page_init (void);
+void page_table_init (struct hash *);
+void page_table_destroy (struct hash *);
+
+bool page_add_file (void *upage, struct file *, off_t ofs,
+                    size_t read_bytes, bool writable);
+bool page_add_mmap (void *upage, struct file *, off_t ofs,
+                    size_t read_bytes);
+bool page_add_zero (void *upage, bool writable);
+void page_remove (void *upage);
+struct page *page_lookup (const void *upage);
+bool page_fault_in (const void *fault_addr);
+bool page_grow_stack (const void *fault_addr, const void *esp);
+bool page_table_copy (struct hash *parent_pages, struct file *exe);
+bool page_copy_on_write (const void *fault_addr);
+bool page_pin (const void *uaddr, bool write);
+void page_unpin (const void *uaddr);
+
+#endif /* vm/page.h */
@@ -0,0 +1,126 @@
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <stdio.h>
+#include "devices/block.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Swap manager.
+
+   The swap device is divided into page-sized slots of
+   SECTORS_PER_SLOT consecutive sectors.  A bitmap records which
+   slots hold a page; a slot is allocated when a page is evicted
+   and freed as soon as the page is read back in or its process
+   exits.  If there is no swap device, every swap_out() fails. */
+
+/* Number of sectors in one slot. */
+#define SECTORS_PER_SLOT (PGSIZE / BLOCK_SECTOR_SIZE)
+
+static struct block *swap_block;        /* Swap device, if any. */
+static struct bitmap *used_slots;       /* Slots in use. */
+static struct mutex swap_mutex;         /* Protects USED_SLOTS. */
+
+/* Statistics. */
+static long long out_cnt;               /* # of pages written. */
+static long long in_cnt;                /* # of pages read. */
+
+/* Reads the page in SLOT into KPAGE. */
+static void
+read_slot (size_t slot, void *kpage) 
+{
+  size_t i;
+
+  ASSERT (used_slots != NULL && bitmap_test (used_slots, slot));
+
+  for (i = 0; i < SECTORS_PER_SLOT; i++)
+    block_read (swap_block, slot * SECTORS_PER_SLOT + i,
+                (uint8_t *) kpage + i * BLOCK_SECTOR_SIZE);
+}
+
+/* Initializes the swap manager.  Must be called after the block
+   devices have been assigned their roles. */
+void
+swap_init (void) 
+{
+  mutex_init (&swap_mutex);
+  swap_block = block_get_role (BLOCK_SWAP);
+  if (swap_block == NULL)
+    return;
+  used_slots = bitmap_create (block_size (swap_block) / SECTORS_PER_SLOT);
+  if (used_slots == NULL)
+    PANIC ("bitmap creation failed--swap device is too large");
+}
+
+/* Writes the page at KPAGE to a free swap slot and returns the
+   slot, or SWAP_ERROR if there is no free slot. */
+size_t
+swap_out (const void *kpage) 
+{
+  size_t slot;
+  size_t i;
+
+  if (used_slots == NULL)
+    return SWAP_ERROR;
+
+  mutex_acquire (&swap_mutex);
+  slot = bitmap_scan_and_flip (used_slots, 0, 1, false);
+  mutex_release (&swap_mutex);
+  if (slot == BITMAP_ERROR)
+    return SWAP_ERROR;
+
+  for (i = 0; i < SECTORS_PER_SLOT; i++)
+    block_write (swap_block, slot * SECTORS_PER_SLOT + i,
+                 (const uint8_t *) kpage + i * BLOCK_SECTOR_SIZE);
+  out_cnt++;
+  return slot;
+}
+
+/* Reads the page in SLOT into KPAGE and frees SLOT. */
+void
+swap_in (size_t slot, void *kpage) 
+{
+  read_slot (slot, kpage);
+  in_cnt++;
+  swap_free (slot);
+}
+
+/* Copies the page in SLOT to a free slot and returns the new
+   slot, or SWAP_ERROR if there is no free slot or no memory. */
+size_t
+swap_dup (size_t slot) 
+{
+  void *bounce;
+  size_t copy;
+
+  bounce = palloc_get_page (0);
+  if (bounce == NULL)
+    return SWAP_ERROR;
+  read_slot (slot, bounce);
+  copy = swap_out (bounce);
+  palloc_free_page (bounce);
+  return copy;
+}
+
+/* Frees SLOT without reading it. */
+void
+swap_free (size_t slot) 
+{
+  ASSERT (used_slots != NULL && bitmap_test (used_slots, slot));
+
+  mutex_acquire (&swap_mutex);
+  bitmap_reset (used_slots, slot);
+  mutex_release (&swap_mutex);
+}
+
+/* Prints swap statistics. */
+void
+swap_print_stats (void) 
+{
+  if (used_slots == NULL)
+    return;
+  printf ("Swap: %zu of %zu slots used, %lld pages out, %lld pages in\n",
+          bitmap_count (used_slots, 0, bitmap_size (used_slots), true),
+          bitmap_size (used_slots), out_cnt, in_cnt);
+}